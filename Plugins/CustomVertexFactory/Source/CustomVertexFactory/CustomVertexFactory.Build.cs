@@ -26,6 +26,7 @@ public class CustomVertexFactory : ModuleRules
 			new string[]
 			{
 				"Core",
+				"NetCore",
 				// ... add other public dependencies that you statically link with here ...
 			}
 			);
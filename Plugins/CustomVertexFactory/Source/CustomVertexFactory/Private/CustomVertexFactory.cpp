@@ -1,22 +1,29 @@
 // Copyright Epic Games, Inc. All Rights Reserved.
 
 #include "CustomVertexFactory.h"
+#include "DeformMeshResourcePool.h"
+#include "DeformMeshStats.h"
 
 #include "Interfaces/IPluginManager.h"
 
 #define LOCTEXT_NAMESPACE "FCustomVertexFactoryModule"
 
+DEFINE_LOG_CATEGORY(LogDeformMesh);
+
 void FCustomVertexFactoryModule::StartupModule()
 {
 	// This code will execute after your module is loaded into memory; the exact timing is specified in the .uplugin file per-module
 	const FString ShaderDirectory = FPaths::Combine(IPluginManager::Get().FindPlugin(TEXT("CustomVertexFactory"))->GetBaseDir(), TEXT("Shaders/Private"));
 	AddShaderSourceDirectoryMapping("/CustomVertexFactory", ShaderDirectory);
+
+	FDeformMeshResourcePool::Startup();
 }
 
 void FCustomVertexFactoryModule::ShutdownModule()
 {
 	// This function may be called during shutdown to clean up your module.  For modules that support dynamic reloading,
 	// we call this function before unloading the module.
+	FDeformMeshResourcePool::Shutdown();
 }
 
 #undef LOCTEXT_NAMESPACE
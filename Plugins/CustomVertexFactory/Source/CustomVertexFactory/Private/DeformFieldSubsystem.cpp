@@ -0,0 +1,436 @@
+﻿// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "DeformFieldSubsystem.h"
+#include "DeformMeshComponent.h"
+
+/* Components or fields that cover more cells than this are not binned, they go in the overflow cell that is tested against everything instead*/
+static const int32 MaxCellsPerEntry = 512;
+static const FIntVector OverflowCell(MAX_int32);
+
+/* Number of cells covered by the box going from MinCell to MaxCell*/
+static int64 GetNumCells(const FIntVector& MinCell, const FIntVector& MaxCell)
+{
+	return int64(MaxCell.X - MinCell.X + 1) * int64(MaxCell.Y - MinCell.Y + 1) * int64(MaxCell.Z - MinCell.Z + 1);
+}
+
+/* Call Func with each cell of the box going from MinCell to MaxCell*/
+template <typename FuncType>
+static void ForEachCell(const FIntVector& MinCell, const FIntVector& MaxCell, FuncType Func)
+{
+	for (int32 Z = MinCell.Z; Z <= MaxCell.Z; Z++)
+	{
+		for (int32 Y = MinCell.Y; Y <= MaxCell.Y; Y++)
+		{
+			for (int32 X = MinCell.X; X <= MaxCell.X; X++)
+			{
+				Func(FIntVector(X, Y, Z));
+			}
+		}
+	}
+}
+
+static void AddToGrid(TMap<FIntVector, TArray<int32>>& Grid, const FIntVector& MinCell, const FIntVector& MaxCell, int32 Id)
+{
+	if (GetNumCells(MinCell, MaxCell) > MaxCellsPerEntry)
+	{
+		Grid.FindOrAdd(OverflowCell).Add(Id);
+		return;
+	}
+
+	ForEachCell(MinCell, MaxCell, [&Grid, Id](const FIntVector& Cell)
+	{
+		Grid.FindOrAdd(Cell).Add(Id);
+	});
+}
+
+static void RemoveFromGrid(TMap<FIntVector, TArray<int32>>& Grid, const FIntVector& MinCell, const FIntVector& MaxCell, int32 Id)
+{
+	auto RemoveFromCell = [&Grid, Id](const FIntVector& Cell)
+	{
+		if (TArray<int32>* CellIds = Grid.Find(Cell))
+		{
+			CellIds->RemoveSingleSwap(Id, false);
+			//Empty cells are dropped, the grids only keep the cells that are in use
+			if (CellIds->Num() == 0)
+			{
+				Grid.Remove(Cell);
+			}
+		}
+	};
+
+	if (GetNumCells(MinCell, MaxCell) > MaxCellsPerEntry)
+	{
+		RemoveFromCell(OverflowCell);
+		return;
+	}
+	ForEachCell(MinCell, MaxCell, RemoveFromCell);
+}
+
+UDeformFieldSubsystem::UDeformFieldSubsystem()
+	: CellSize(500.f)
+	, bGridDirty(false)
+{
+}
+
+FIntVector UDeformFieldSubsystem::GetCell(const FVector& Location) const
+{
+	return FIntVector(FMath::FloorToInt(Location.X / CellSize),
+	                  FMath::FloorToInt(Location.Y / CellSize),
+	                  FMath::FloorToInt(Location.Z / CellSize));
+}
+
+UDeformFieldSubsystem::FCellRange UDeformFieldSubsystem::GetCellRange(const FBox& WorldBox) const
+{
+	return {GetCell(WorldBox.Min), GetCell(WorldBox.Max)};
+}
+
+int32 UDeformFieldSubsystem::AddDeformField(const FVector& Position, const FTransform& Transform, float Radius)
+{
+	FDeformMeshField Field;
+	Field.Position = Position;
+	Field.DeformTransform = Transform.ToMatrixWithScale().GetTransposed();
+	Field.Radius = FMath::Max(Radius, 0.f);
+
+	const int32 FieldId = Fields.Add(Field);
+	BinField(FieldId);
+	DirtyFieldBoxes.Add(Field.GetBoundingBox());
+	return FieldId;
+}
+
+void UDeformFieldSubsystem::UpdateDeformField(int32 FieldId, const FVector& Position, const FTransform& Transform, float Radius)
+{
+	if (Fields.IsValidIndex(FieldId))
+	{
+		//The components overlapped before the update lose the field, the ones overlapped after get it
+		FDeformMeshField& Field = Fields[FieldId];
+		DirtyFieldBoxes.Add(Field.GetBoundingBox());
+		UnbinField(FieldId);
+
+		Field.Position = Position;
+		Field.DeformTransform = Transform.ToMatrixWithScale().GetTransposed();
+		Field.Radius = FMath::Max(Radius, 0.f);
+
+		BinField(FieldId);
+		DirtyFieldBoxes.Add(Field.GetBoundingBox());
+	}
+}
+
+void UDeformFieldSubsystem::RemoveDeformField(int32 FieldId)
+{
+	if (Fields.IsValidIndex(FieldId))
+	{
+		DirtyFieldBoxes.Add(Fields[FieldId].GetBoundingBox());
+		UnbinField(FieldId);
+		Fields.RemoveAt(FieldId);
+	}
+}
+
+int32 UDeformFieldSubsystem::GetNumDeformFields() const
+{
+	return Fields.Num();
+}
+
+void UDeformFieldSubsystem::SetCellSize(float NewCellSize)
+{
+	if (NewCellSize > KINDA_SMALL_NUMBER)
+	{
+		CellSize = NewCellSize;
+		bGridDirty = true;
+	}
+}
+
+void UDeformFieldSubsystem::RegisterComponent(UDeformMeshComponent* Component)
+{
+	if (!ComponentIds.Contains(Component))
+	{
+		//The component is binned and gets its fields on the next update
+		const int32 ComponentId = Components.Add(Component);
+		ComponentIds.Add(Component, ComponentId);
+		DirtyComponents.Add(ComponentId);
+	}
+}
+
+void UDeformFieldSubsystem::UnregisterComponent(UDeformMeshComponent* Component)
+{
+	if (const int32* ComponentId = ComponentIds.Find(Component))
+	{
+		RemoveComponent(*ComponentId);
+	}
+}
+
+void UDeformFieldSubsystem::MarkComponentDirty(UDeformMeshComponent* Component)
+{
+	if (const int32* ComponentId = ComponentIds.Find(Component))
+	{
+		DirtyComponents.Add(*ComponentId);
+	}
+}
+
+void UDeformFieldSubsystem::BinField(int32 FieldId)
+{
+	const FCellRange Cells = GetCellRange(Fields[FieldId].GetBoundingBox());
+	FieldCells.Insert(FieldId, Cells);
+	AddToGrid(FieldGrid, Cells.MinCell, Cells.MaxCell, FieldId);
+}
+
+void UDeformFieldSubsystem::UnbinField(int32 FieldId)
+{
+	const FCellRange& Cells = FieldCells[FieldId];
+	RemoveFromGrid(FieldGrid, Cells.MinCell, Cells.MaxCell, FieldId);
+	FieldCells.RemoveAt(FieldId);
+}
+
+void UDeformFieldSubsystem::BinComponent(int32 ComponentId)
+{
+	const FCellRange Cells = GetCellRange(Components[ComponentId]->Bounds.GetBox());
+	if (ComponentCells.IsAllocated(ComponentId))
+	{
+		//Most updates move a component within the cells it already covers
+		FCellRange& OldCells = ComponentCells[ComponentId];
+		if (OldCells == Cells)
+		{
+			return;
+		}
+		RemoveFromGrid(ComponentGrid, OldCells.MinCell, OldCells.MaxCell, ComponentId);
+		OldCells = Cells;
+	}
+	else
+	{
+		ComponentCells.Insert(ComponentId, Cells);
+	}
+	AddToGrid(ComponentGrid, Cells.MinCell, Cells.MaxCell, ComponentId);
+}
+
+void UDeformFieldSubsystem::RemoveComponent(int32 ComponentId)
+{
+	if (ComponentCells.IsAllocated(ComponentId))
+	{
+		const FCellRange& Cells = ComponentCells[ComponentId];
+		RemoveFromGrid(ComponentGrid, Cells.MinCell, Cells.MaxCell, ComponentId);
+		ComponentCells.RemoveAt(ComponentId);
+	}
+	ComponentIds.Remove(Components[ComponentId]);
+	Components.RemoveAt(ComponentId);
+	DirtyComponents.Remove(ComponentId);
+}
+
+void UDeformFieldSubsystem::RebuildGrids()
+{
+	FieldGrid.Reset();
+	FieldCells.Empty();
+	for (auto FieldIt = Fields.CreateConstIterator(); FieldIt; ++FieldIt)
+	{
+		BinField(FieldIt.GetIndex());
+	}
+
+	//The components are binned again by the next AssignFields, the fields they get don't depend on the cells
+	ComponentGrid.Reset();
+	ComponentCells.Empty();
+	for (auto ComponentIt = Components.CreateConstIterator(); ComponentIt; ++ComponentIt)
+	{
+		DirtyComponents.Add(ComponentIt.GetIndex());
+	}
+}
+
+void UDeformFieldSubsystem::AssignComponentFields(UDeformMeshComponent* Component, int32 ComponentId, TArray<int32>& LastTestedComponent) const
+{
+	const FBox WorldBox = Component->Bounds.GetBox();
+
+	//Test the sections in the local space of the component, the radius is scaled conservatively
+	const FTransform& ComponentToWorld = Component->GetComponentTransform();
+	const float LocalRadiusScale = 1.f / FMath::Max(ComponentToWorld.GetMinimumAxisScale(), KINDA_SMALL_NUMBER);
+
+	//The list of field ids of each section, only allocated if a field overlaps the component
+	const int32 NumSections = Component->SectionMeshes.Num();
+	TArray<TArray<int32>> SectionFields;
+
+	auto TestFields = [&](const TArray<int32>& CellFields)
+	{
+		for (const int32 FieldId : CellFields)
+		{
+			//A field spanning several cells of the component is only tested once
+			if (LastTestedComponent[FieldId] == ComponentId)
+			{
+				continue;
+			}
+			LastTestedComponent[FieldId] = ComponentId;
+
+			const FDeformMeshField& Field = Fields[FieldId];
+			if (!FMath::SphereAABBIntersection(Field.Position, FMath::Square(Field.Radius), WorldBox))
+			{
+				continue;
+			}
+
+			const FVector LocalPosition = ComponentToWorld.InverseTransformPosition(Field.Position);
+			const float LocalRadius = Field.Radius * LocalRadiusScale;
+			for (int32 SectionIdx = 0; SectionIdx < NumSections; SectionIdx++)
+			{
+				if (Component->SectionMeshes[SectionIdx] != nullptr &&
+					FMath::SphereAABBIntersection(LocalPosition, FMath::Square(LocalRadius), Component->SectionLocalBoxes[SectionIdx]))
+				{
+					SectionFields.SetNum(NumSections);
+					SectionFields[SectionIdx].Add(FieldId);
+				}
+			}
+		}
+	};
+
+	if (const TArray<int32>* OverflowFields = FieldGrid.Find(OverflowCell))
+	{
+		TestFields(*OverflowFields);
+	}
+
+	//A component bigger than the grid is cheaper to test against all the cells than to walk every cell it covers
+	const FCellRange& Cells = ComponentCells[ComponentId];
+	if (GetNumCells(Cells.MinCell, Cells.MaxCell) > FMath::Max(FieldGrid.Num(), MaxCellsPerEntry))
+	{
+		for (const TPair<FIntVector, TArray<int32>>& Cell : FieldGrid)
+		{
+			TestFields(Cell.Value);
+		}
+	}
+	else
+	{
+		ForEachCell(Cells.MinCell, Cells.MaxCell, [this, &TestFields](const FIntVector& Cell)
+		{
+			if (const TArray<int32>* CellFields = FieldGrid.Find(Cell))
+			{
+				TestFields(*CellFields);
+			}
+		});
+	}
+
+	//Pack the fields so that the fields of a section are contiguous, in id order so an unchanged assignment packs the same
+	TArray<FDeformMeshFieldGPU> PackedFields;
+	TArray<FIntPoint> SectionRanges;
+	if (SectionFields.Num() > 0)
+	{
+		SectionRanges.SetNumZeroed(NumSections);
+		for (int32 SectionIdx = 0; SectionIdx < NumSections; SectionIdx++)
+		{
+			TArray<int32>& SectionFieldIds = SectionFields[SectionIdx];
+			SectionFieldIds.Sort();
+			SectionRanges[SectionIdx] = FIntPoint(PackedFields.Num(), SectionFieldIds.Num());
+			for (const int32 FieldId : SectionFieldIds)
+			{
+				PackedFields.Emplace(Fields[FieldId]);
+			}
+		}
+	}
+
+	//The component skips the update if its fields didn't change, a component that isn't overlapped anymore is cleared
+	Component->SetDeformFields(MoveTemp(PackedFields), MoveTemp(SectionRanges));
+}
+
+void UDeformFieldSubsystem::AssignFields()
+{
+	if (bGridDirty)
+	{
+		RebuildGrids();
+		bGridDirty = false;
+	}
+
+	//Bin the dirty components at their new bounds, and drop the ones destroyed without unregistering
+	TSet<int32> ComponentsToAssign = MoveTemp(DirtyComponents);
+	DirtyComponents.Reset();
+	TArray<int32> StaleComponents;
+	for (const int32 ComponentId : ComponentsToAssign)
+	{
+		if (Components[ComponentId].IsValid())
+		{
+			BinComponent(ComponentId);
+		}
+		else
+		{
+			StaleComponents.Add(ComponentId);
+		}
+	}
+
+	//The components overlapped by a field before or after it changed are assigned again too
+	const TArray<int32>* OverflowComponents = ComponentGrid.Find(OverflowCell);
+	for (const FBox& FieldBox : DirtyFieldBoxes)
+	{
+		auto AddOverlappedComponents = [&](const TArray<int32>& CellComponents)
+		{
+			for (const int32 ComponentId : CellComponents)
+			{
+				const UDeformMeshComponent* Component = Components[ComponentId].Get();
+				if (Component == nullptr)
+				{
+					StaleComponents.AddUnique(ComponentId);
+				}
+				else if (FieldBox.Intersect(Component->Bounds.GetBox()))
+				{
+					ComponentsToAssign.Add(ComponentId);
+				}
+			}
+		};
+
+		if (OverflowComponents)
+		{
+			AddOverlappedComponents(*OverflowComponents);
+		}
+
+		//A field bigger than the grid is cheaper to test against all the cells than to walk every cell it covers
+		const FCellRange Cells = GetCellRange(FieldBox);
+		if (GetNumCells(Cells.MinCell, Cells.MaxCell) > FMath::Max(ComponentGrid.Num(), MaxCellsPerEntry))
+		{
+			for (const TPair<FIntVector, TArray<int32>>& Cell : ComponentGrid)
+			{
+				AddOverlappedComponents(Cell.Value);
+			}
+			continue;
+		}
+
+		ForEachCell(Cells.MinCell, Cells.MaxCell, [this, &AddOverlappedComponents](const FIntVector& Cell)
+		{
+			if (const TArray<int32>* CellComponents = ComponentGrid.Find(Cell))
+			{
+				AddOverlappedComponents(*CellComponents);
+			}
+		});
+	}
+	DirtyFieldBoxes.Reset();
+
+	for (const int32 ComponentId : StaleComponents)
+	{
+		ComponentsToAssign.Remove(ComponentId);
+		RemoveComponent(ComponentId);
+	}
+
+	//Id of the last component that tested each field, so a field spanning several cells is only tested once per component
+	TArray<int32> LastTestedComponent;
+	LastTestedComponent.Init(INDEX_NONE, Fields.GetMaxIndex());
+
+	for (const int32 ComponentId : ComponentsToAssign)
+	{
+		AssignComponentFields(Components[ComponentId].Get(), ComponentId, LastTestedComponent);
+	}
+}
+
+void UDeformFieldSubsystem::Tick(float DeltaTime)
+{
+	AssignFields();
+}
+
+ETickableTickType UDeformFieldSubsystem::GetTickableTickType() const
+{
+	return ETickableTickType::Conditional;
+}
+
+bool UDeformFieldSubsystem::IsTickable() const
+{
+	//Without fields the dirty components have nothing to get, they're binned once a field shows up
+	return !IsTemplate() && (bGridDirty || DirtyFieldBoxes.Num() > 0 || (DirtyComponents.Num() > 0 && Fields.Num() > 0));
+}
+
+UWorld* UDeformFieldSubsystem::GetTickableGameObjectWorld() const
+{
+	return GetWorld();
+}
+
+TStatId UDeformFieldSubsystem::GetStatId() const
+{
+	RETURN_QUICK_DECLARE_CYCLE_STAT(UDeformFieldSubsystem, STATGROUP_Tickables);
+}
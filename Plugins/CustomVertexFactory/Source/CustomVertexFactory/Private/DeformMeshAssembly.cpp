@@ -0,0 +1,103 @@
+﻿// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "DeformMeshAssembly.h"
+#include "DeformMeshComponent.h"
+#include "Engine/StaticMesh.h"
+#include "Serialization/CustomVersion.h"
+
+/* Versions of the data of UDeformMeshAssembly that isn't saved as properties*/
+struct FDeformMeshAssemblyCustomVersion
+{
+	enum Type
+	{
+		// The section table and the derived data of the meshes
+		InitialVersion = 0,
+
+		VersionPlusOne,
+		LatestVersion = VersionPlusOne - 1
+	};
+
+	static const FGuid GUID;
+};
+
+const FGuid FDeformMeshAssemblyCustomVersion::GUID(0x2B7E9D14, 0x4C6A4F83, 0xB05E1A97, 0xD3F8624C);
+static FCustomVersionRegistration GRegisterDeformMeshAssemblyCustomVersion(FDeformMeshAssemblyCustomVersion::GUID, FDeformMeshAssemblyCustomVersion::LatestVersion, TEXT("DeformMeshAssemblyVer"));
+
+void UDeformMeshAssembly::Serialize(FArchive& Ar)
+{
+	Super::Serialize(Ar);
+
+	Ar.UsingCustomVersion(FDeformMeshAssemblyCustomVersion::GUID);
+	Sections.BulkSerialize(Ar);
+
+	int32 NumDerivedData = MeshDerivedData.Num();
+	Ar << NumDerivedData;
+	if (Ar.IsLoading())
+	{
+		MeshDerivedData.Reset(NumDerivedData);
+		for (int32 MeshIdx = 0; MeshIdx < NumDerivedData; MeshIdx++)
+		{
+			MeshDerivedData.Add(FDeformMeshDerivedData::MakeForLoading());
+		}
+	}
+	for (const TSharedPtr<FDeformMeshDerivedData, ESPMode::ThreadSafe>& DerivedData : MeshDerivedData)
+	{
+		DerivedData->Serialize(Ar);
+	}
+}
+
+void UDeformMeshAssembly::PostLoad()
+{
+	Super::PostLoad();
+
+	// The meshes are loaded before the assembly, their render data can take the loaded derived data
+	for (int32 MeshIdx = 0; MeshIdx < Meshes.Num() && MeshIdx < MeshDerivedData.Num(); MeshIdx++)
+	{
+		if (Meshes[MeshIdx])
+		{
+			Meshes[MeshIdx]->ConditionalPostLoad();
+			FDeformMeshDerivedData::Register(Meshes[MeshIdx], MeshDerivedData[MeshIdx]);
+		}
+	}
+}
+
+#if WITH_EDITOR
+void UDeformMeshAssembly::CaptureComponent(const UDeformMeshComponent* Component, EDeformMeshDerivedDataFlags DerivedDataFlags)
+{
+	Meshes.Reset();
+	Materials.Reset();
+	Sections.Reset(Component->SectionMeshes.Num());
+	MeshDerivedData.Reset();
+
+	for (int32 SectionIdx = 0; SectionIdx < Component->SectionMeshes.Num(); SectionIdx++)
+	{
+		const int32 SectionIndex = Component->DenseSectionSlots[SectionIdx];
+
+		// Zeroed so the padding saved with the table is always the same
+		FDeformMeshAssemblySection& Section = Sections.AddZeroed_GetRef();
+		Section.SectionIndex = SectionIndex;
+		Section.MeshIndex = Meshes.AddUnique(Component->SectionMeshes[SectionIdx]);
+		UMaterialInterface* Material = Component->GetMaterial(SectionIndex);
+		Section.MaterialIndex = Material ? Materials.AddUnique(Material) : INDEX_NONE;
+		Section.ParentSectionIndex = Component->SectionParents[SectionIdx];
+		Section.DeformTransform = Component->SectionDeformTransforms[SectionIdx];
+		Section.LocalTransform = Component->SectionLocalTransforms[SectionIdx];
+		Section.LocalBox = Component->SectionLocalBoxes[SectionIdx];
+		Section.bVisible = Component->SectionVisibility[SectionIdx];
+	}
+
+	// The derived data is shared with the components using the meshes, a later Get can still build the missing parts into it
+	// Only the parts built by now are saved, a part that was built is never built again
+	for (UStaticMesh* Mesh : Meshes)
+	{
+		MeshDerivedData.Add(FDeformMeshDerivedData::Get(Mesh, DerivedDataFlags));
+		if (!MeshDerivedData.Last().IsValid())
+		{
+			MeshDerivedData.Last() = FDeformMeshDerivedData::MakeForLoading();
+		}
+	}
+
+	MarkPackageDirty();
+}
+#endif
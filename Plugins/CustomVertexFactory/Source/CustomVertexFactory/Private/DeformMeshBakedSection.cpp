@@ -0,0 +1,70 @@
+﻿// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "DeformMeshBakedSection.h"
+#include "DeformMeshMath.h"
+#include "DeformMeshStats.h"
+#include "StaticMeshResources.h"
+
+DECLARE_CYCLE_STAT(TEXT("Bake Section"), STAT_DeformMesh_BakeSection, STATGROUP_DeformMesh);
+DECLARE_MEMORY_STAT(TEXT("Baked Section Memory"), STAT_DeformMesh_BakedMemory, STATGROUP_DeformMesh);
+
+FDeformMeshBakedSection::FDeformMeshBakedSection(ERHIFeatureLevel::Type InFeatureLevel, const FMatrix& InDeformTransform)
+	: VertexFactory(InFeatureLevel, "FDeformMeshBakedSection")
+	, DeformTransform(InDeformTransform)
+{
+}
+
+FDeformMeshBakedSection::~FDeformMeshBakedSection()
+{
+	check(IsInRenderingThread());
+	DEC_MEMORY_STAT_BY(STAT_DeformMesh_BakedMemory, GetResourceSize());
+	VertexFactory.ReleaseResource();
+	Positions.ReleaseResource();
+}
+
+TArray<FVector> FDeformMeshBakedSection::BakePositions(TArray<FVector>&& LocalPositions, const FMatrix& LocalToWorld, const FMatrix& DeformTransform,
+                                                       const TArray<FDeformMeshFieldGPU>& Fields)
+{
+	SCOPE_CYCLE_COUNTER(STAT_DeformMesh_BakeSection);
+
+	//The static draw applies the local to world transform of the component, so the deformed positions go back to the local space
+	const FMatrix WorldToLocal = LocalToWorld.Inverse();
+	for (FVector& Position : LocalPositions)
+	{
+		Position = WorldToLocal.TransformPosition(DeformMeshMath::CalcWorldPosition(Position, LocalToWorld, DeformTransform, Fields.GetData(), Fields.Num()));
+	}
+	return MoveTemp(LocalPositions);
+}
+
+TSharedPtr<FDeformMeshBakedSection, ESPMode::ThreadSafe> FDeformMeshBakedSection::Create(ERHIFeatureLevel::Type FeatureLevel, const FMatrix& DeformTransform,
+                                                                                         TArray<FVector>&& BakedPositions, FStaticMeshVertexBuffers* VertexBuffers)
+{
+	check(IsInGameThread());
+	TSharedPtr<FDeformMeshBakedSection, ESPMode::ThreadSafe> Baked = MakeShareable(new FDeformMeshBakedSection(FeatureLevel, DeformTransform), [](FDeformMeshBakedSection* Data)
+	{
+		ENQUEUE_RENDER_COMMAND(FDeformMeshReleaseBakedSection)([Data](FRHICommandListImmediate& RHICmdList)
+		{
+			delete Data;
+		});
+	});
+	Baked->Positions.Init(BakedPositions, false);
+	INC_MEMORY_STAT_BY(STAT_DeformMesh_BakedMemory, Baked->GetResourceSize());
+
+	//Enqueued before the creation of the scene proxy that draws it
+	FDeformMeshBakedSection* Data = Baked.Get();
+	ENQUEUE_RENDER_COMMAND(FDeformMeshInitBakedSection)([Data, VertexBuffers](FRHICommandListImmediate& RHICmdList)
+	{
+		Data->Positions.InitResource();
+
+		FLocalVertexFactory::FDataType VertexData;
+		Data->Positions.BindPositionVertexBuffer(&Data->VertexFactory, VertexData);
+		VertexBuffers->StaticMeshVertexBuffer.BindTangentVertexBuffer(&Data->VertexFactory, VertexData);
+		VertexBuffers->StaticMeshVertexBuffer.BindPackedTexCoordVertexBuffer(&Data->VertexFactory, VertexData);
+		VertexBuffers->StaticMeshVertexBuffer.BindLightMapVertexBuffer(&Data->VertexFactory, VertexData, 0);
+		VertexBuffers->ColorVertexBuffer.BindColorVertexBuffer(&Data->VertexFactory, VertexData);
+		Data->VertexFactory.SetData(VertexData);
+		Data->VertexFactory.InitResource();
+	});
+	return Baked;
+}
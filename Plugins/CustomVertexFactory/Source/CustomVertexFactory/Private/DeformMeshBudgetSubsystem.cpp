@@ -0,0 +1,186 @@
+﻿// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "DeformMeshBudgetSubsystem.h"
+#include "DeformMeshComponent.h"
+#include "DeformMeshStats.h"
+#include "Camera/PlayerCameraManager.h"
+#include "GameFramework/PlayerController.h"
+
+DECLARE_CYCLE_STAT(TEXT("Update Budget"), STAT_DeformMesh_UpdateBudget, STATGROUP_DeformMesh);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Budgeted Section Updates"), STAT_DeformMesh_BudgetedSectionUpdates, STATGROUP_DeformMesh);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Budgeted Upload Bytes"), STAT_DeformMesh_BudgetedUploadBytes, STATGROUP_DeformMesh);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Deferred Components"), STAT_DeformMesh_DeferredComponents, STATGROUP_DeformMesh);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Starved Components"), STAT_DeformMesh_StarvedComponents, STATGROUP_DeformMesh);
+
+UDeformMeshBudgetSubsystem::UDeformMeshBudgetSubsystem()
+	: MaxSectionUpdatesPerFrame(4096)
+	, MaxUploadBytesPerFrame(1024 * 1024)
+	, FullRateScreenSize(0.1f)
+	, MaxUpdateInterval(8)
+	, MaxStarvedFrames(16)
+{
+}
+
+void UDeformMeshBudgetSubsystem::RegisterComponent(UDeformMeshComponent* Component)
+{
+	if (!Components.ContainsByPredicate([Component](const FBudgetedComponent& Entry) { return Entry.Component == Component; }))
+	{
+		Components.Add({Component, 0, 1.f});
+	}
+}
+
+void UDeformMeshBudgetSubsystem::UnregisterComponent(UDeformMeshComponent* Component)
+{
+	Components.RemoveAllSwap([Component](const FBudgetedComponent& Entry) { return Entry.Component == Component; });
+}
+
+void UDeformMeshBudgetSubsystem::SetBudget(int32 InMaxSectionUpdatesPerFrame, int32 InMaxUploadBytesPerFrame)
+{
+	MaxSectionUpdatesPerFrame = FMath::Max(InMaxSectionUpdatesPerFrame, 1);
+	MaxUploadBytesPerFrame = FMath::Max(InMaxUploadBytesPerFrame, 1);
+}
+
+void UDeformMeshBudgetSubsystem::SetUpdateIntervals(float InFullRateScreenSize, int32 InMaxUpdateInterval, int32 InMaxStarvedFrames)
+{
+	FullRateScreenSize = FMath::Max(InFullRateScreenSize, 0.f);
+	MaxUpdateInterval = FMath::Max(InMaxUpdateInterval, 1);
+	// A component can't be starved before its regular interval is over
+	MaxStarvedFrames = FMath::Max(InMaxStarvedFrames, MaxUpdateInterval);
+}
+
+void UDeformMeshBudgetSubsystem::UpdateSignificance()
+{
+	//Drop the components that were destroyed without unregistering
+	Components.RemoveAllSwap([](const FBudgetedComponent& Entry) { return !Entry.Component.IsValid(); });
+
+	struct FViewer
+	{
+		FVector Location;
+		float ScreenScale;
+	};
+	TArray<FViewer, TInlineAllocator<4>> Viewers;
+	for (FConstPlayerControllerIterator It = GetWorld()->GetPlayerControllerIterator(); It; ++It)
+	{
+		const APlayerController* PlayerController = It->Get();
+		if (PlayerController && PlayerController->IsLocalController())
+		{
+			FVector Location;
+			FRotator Rotation;
+			PlayerController->GetPlayerViewPoint(Location, Rotation);
+			const float FOV = PlayerController->PlayerCameraManager ? PlayerController->PlayerCameraManager->GetFOVAngle() : 90.f;
+			Viewers.Add({Location, 1.f / FMath::Tan(FMath::DegreesToRadians(FMath::Clamp(FOV, 1.f, 170.f)) * 0.5f)});
+		}
+	}
+
+	for (FBudgetedComponent& Entry : Components)
+	{
+		//Without a viewer (dedicated server, editor worlds) everything is considered significant
+		if (Viewers.Num() == 0)
+		{
+			Entry.Significance = 1.f;
+			continue;
+		}
+
+		//Ratio of the bounding sphere radius to the half width of the screen, from the viewer that sees it the biggest
+		const FBoxSphereBounds& Bounds = Entry.Component->Bounds;
+		Entry.Significance = 0.f;
+		for (const FViewer& Viewer : Viewers)
+		{
+			const float Distance = FVector::Dist(Viewer.Location, Bounds.Origin);
+			const float ScreenSize = Distance > Bounds.SphereRadius
+				                         ? Bounds.SphereRadius * Viewer.ScreenScale / Distance
+				                         : 1.f;
+			Entry.Significance = FMath::Max(Entry.Significance, ScreenSize);
+		}
+	}
+}
+
+void UDeformMeshBudgetSubsystem::Tick(float DeltaTime)
+{
+	SCOPE_CYCLE_COUNTER(STAT_DeformMesh_UpdateBudget);
+
+	UpdateSignificance();
+
+	int32 SectionUpdates = 0;
+	int32 UploadBytes = 0;
+	auto Flush = [&](FBudgetedComponent& Entry)
+	{
+		SectionUpdates += Entry.Component->GetNumPendingTransformUpdates();
+		UploadBytes += Entry.Component->GetTransformsUploadSize();
+		Entry.Component->SendTransformsUpdate();
+		Entry.FramesSinceUpdate = 0;
+	};
+
+	//Starved components are sent first whatever the budget, the others must wait for their interval to be over
+	TArray<FBudgetedComponent*, TInlineAllocator<64>> DueComponents;
+	for (FBudgetedComponent& Entry : Components)
+	{
+		if (!Entry.Component->HasPendingTransformsUpdate())
+		{
+			Entry.FramesSinceUpdate = 0;
+			continue;
+		}
+
+		Entry.FramesSinceUpdate++;
+		if (Entry.FramesSinceUpdate >= MaxStarvedFrames)
+		{
+			INC_DWORD_STAT(STAT_DeformMesh_StarvedComponents);
+			Flush(Entry);
+			continue;
+		}
+
+		const int32 UpdateInterval = Entry.Significance >= FullRateScreenSize
+			                             ? 1
+			                             : FMath::Min(FMath::CeilToInt(FullRateScreenSize / FMath::Max(Entry.Significance, SMALL_NUMBER)), MaxUpdateInterval);
+		if (Entry.FramesSinceUpdate >= UpdateInterval)
+		{
+			DueComponents.Add(&Entry);
+		}
+		else
+		{
+			INC_DWORD_STAT(STAT_DeformMesh_DeferredComponents);
+		}
+	}
+
+	//The most significant components go first, the time spent waiting is a tie breaker that also favors the small ones over time
+	DueComponents.Sort([](const FBudgetedComponent& A, const FBudgetedComponent& B)
+	{
+		return A.Significance * A.FramesSinceUpdate > B.Significance * B.FramesSinceUpdate;
+	});
+
+	for (FBudgetedComponent* Entry : DueComponents)
+	{
+		//Skip the ones that don't fit, a smaller one further in the list may still fit
+		if (SectionUpdates + Entry->Component->GetNumPendingTransformUpdates() > MaxSectionUpdatesPerFrame ||
+			UploadBytes + Entry->Component->GetTransformsUploadSize() > MaxUploadBytesPerFrame)
+		{
+			INC_DWORD_STAT(STAT_DeformMesh_DeferredComponents);
+			continue;
+		}
+		Flush(*Entry);
+	}
+
+	INC_DWORD_STAT_BY(STAT_DeformMesh_BudgetedSectionUpdates, SectionUpdates);
+	INC_DWORD_STAT_BY(STAT_DeformMesh_BudgetedUploadBytes, UploadBytes);
+}
+
+ETickableTickType UDeformMeshBudgetSubsystem::GetTickableTickType() const
+{
+	return ETickableTickType::Conditional;
+}
+
+bool UDeformMeshBudgetSubsystem::IsTickable() const
+{
+	return !IsTemplate() && Components.Num() > 0;
+}
+
+UWorld* UDeformMeshBudgetSubsystem::GetTickableGameObjectWorld() const
+{
+	return GetWorld();
+}
+
+TStatId UDeformMeshBudgetSubsystem::GetStatId() const
+{
+	RETURN_QUICK_DECLARE_CYCLE_STAT(UDeformMeshBudgetSubsystem, STATGROUP_Tickables);
+}
@@ -2,7 +2,68 @@
 
 
 #include "DeformMeshComponent.h"
+#include "DeformFieldSubsystem.h"
+#include "DeformMeshAssembly.h"
+#include "DeformMeshBudgetSubsystem.h"
+#include "DeformMeshMath.h"
 #include "DeformMeshSceneProxy.h"
+#include "DeformMeshStats.h"
+#include "Async/Async.h"
+#include "Async/ParallelFor.h"
+#include "Net/UnrealNetwork.h"
+#include "Serialization/CustomVersion.h"
+
+DECLARE_CYCLE_STAT(TEXT("Refit Section BVHs"), STAT_DeformMesh_RefitBVHs, STATGROUP_DeformMesh);
+DECLARE_CYCLE_STAT(TEXT("Line Trace"), STAT_DeformMesh_LineTrace, STATGROUP_DeformMesh);
+DECLARE_CYCLE_STAT(TEXT("Overlap"), STAT_DeformMesh_Overlap, STATGROUP_DeformMesh);
+DECLARE_CYCLE_STAT(TEXT("Update Section Hierarchy"), STAT_DeformMesh_UpdateHierarchy, STATGROUP_DeformMesh);
+
+/* Versions of the serialized data of UDeformMeshComponent that isn't saved as properties*/
+struct FDeformMeshCustomVersion
+{
+	enum Type
+	{
+		BeforeCustomVersionWasAdded = 0,
+		// The visibility of the sections is saved as a bit array
+		SectionVisibilityBits,
+
+		VersionPlusOne,
+		LatestVersion = VersionPlusOne - 1
+	};
+
+	static const FGuid GUID;
+};
+
+const FGuid FDeformMeshCustomVersion::GUID(0x6C1F3A52, 0x9E4B47D1, 0xA3D8C07E, 0x51B92F64);
+static FCustomVersionRegistration GRegisterDeformMeshCustomVersion(FDeformMeshCustomVersion::GUID, FDeformMeshCustomVersion::LatestVersion, TEXT("DeformMeshVer"));
+
+UDeformMeshComponent::UDeformMeshComponent()
+	: bSectionHierarchyLevelsDirty(false)
+	, bSectionHierarchyDirty(false)
+	, bLocalBoundsDirty(false)
+	, bSectionBVHsQueried(false)
+	, bUseUpdateBudget(false)
+	, bTransformsUpdatePending(false)
+	, bInterpolateTransforms(false)
+	, TransformSampleRate(30.f)
+	, bQuantizePositions(false)
+	, bOptimizeIndexOrder(false)
+	, bSplitDeformClusters(false)
+	, bReleaseHiddenSections(false)
+	, SectionEvictionDelay(5.f)
+	, SectionMemoryBudget(0)
+	, bBakeSettledSections(false)
+	, SettledFramesToBake(30)
+	, Assembly(nullptr)
+	, LastTransformSampleTime(-BIG_NUMBER)
+{
+	ReplicatedSections.Owner = this;
+
+	// Only ticks to drive the residency policy of the render resources and the baking of the settled sections
+	PrimaryComponentTick.bCanEverTick = true;
+	PrimaryComponentTick.bStartWithTickEnabled = false;
+	PrimaryComponentTick.TickInterval = 0.25f;
+}
 
 FBoxSphereBounds UDeformMeshComponent::CalcBounds(const FTransform& LocalToWorld) const
 {
@@ -16,11 +77,12 @@ FBoxSphereBounds UDeformMeshComponent::CalcBounds(const FTransform& LocalToWorld
 
 void UDeformMeshComponent::UpdateLocalBounds()
 {
+	bLocalBoundsDirty = false;
 	FBox LocalBox(ForceInit);
 
-	for (const FDeformMeshSection& Section : DeformMeshSections)
+	for (const FBox& SectionLocalBox : SectionLocalBoxes)
 	{
-		LocalBox += Section.SectionLocalBox;
+		LocalBox += SectionLocalBox;
 	}
 
 	LocalBounds = LocalBox.IsValid
@@ -31,161 +93,1501 @@ void UDeformMeshComponent::UpdateLocalBounds()
 	UpdateBounds();
 	// Need to send to render thread
 	MarkRenderTransformDirty();
+	// The sections overlapped by the deform fields may have changed
+	MarkDeformFieldsDirty();
 }
 
-void UDeformMeshComponent::CreateMeshSection(int32 SectionIndex, UStaticMesh* Mesh, const FTransform& Transform)
+void UDeformMeshComponent::MarkDeformFieldsDirty()
 {
-	// Ensure sections array is long enough
-	if (SectionIndex >= DeformMeshSections.Num())
+	if (UWorld* World = GetWorld())
 	{
-		DeformMeshSections.SetNum(SectionIndex + 1, false);
+		if (UDeformFieldSubsystem* FieldSubsystem = World->GetSubsystem<UDeformFieldSubsystem>())
+		{
+			FieldSubsystem->MarkComponentDirty(this);
+		}
 	}
+}
 
-	// Reset this section (in case it already existed)
-	FDeformMeshSection& NewSection = DeformMeshSections[SectionIndex];
-	NewSection.Reset();
-
-	// Fill in the mesh section with the needed data
-	// I'm assuming that the StaticMesh has only one section and I'm only using that
-	NewSection.StaticMesh = Mesh;
-	NewSection.DeformTransform = Transform.ToMatrixWithScale().GetTransposed();
-
-	//Update the local bound using the bounds of the static mesh that we're adding
-	//I'm not taking in consideration the deformation here, if the deformation cause the mesh to go outside its bounds
-	NewSection.StaticMesh->CalculateExtendedBounds();
-	NewSection.SectionLocalBox += NewSection.StaticMesh->GetBoundingBox();
+void UDeformMeshComponent::Serialize(FArchive& Ar)
+{
+	Super::Serialize(Ar);
 
-	//Add this sections' material to the list of the component's materials, with the same index as the section
-	SetMaterial(SectionIndex, NewSection.StaticMesh->GetMaterial(0));
+	// Data saved before the sections were packed only has the deprecated array, its sections keep their index
+	if (Ar.IsLoading() && DeformMeshSections.Num() > 0)
+	{
+		MigrateDeformMeshSections();
+	}
 
+	Ar.UsingCustomVersion(FDeformMeshCustomVersion::GUID);
+	if (Ar.CustomVer(FDeformMeshCustomVersion::GUID) >= FDeformMeshCustomVersion::SectionVisibilityBits)
+	{
+		Ar << SectionVisibility;
+	}
 
-	UpdateLocalBounds(); // Update overall bounds
-	MarkRenderStateDirty(); // New section requires recreating scene proxy
+	if (Ar.IsLoading())
+	{
+		const int32 NumSections = SectionMeshes.Num();
+		// Older data, or data that doesn't match the sections, shows everything
+		if (SectionVisibility.Num() != NumSections)
+		{
+			SectionVisibility.Init(true, NumSections);
+		}
+		// Same for the hierarchy, everything is a root
+		if (SectionParents.Num() != NumSections || SectionLocalTransforms.Num() != NumSections)
+		{
+			SectionParents.Init(INDEX_NONE, NumSections);
+			SectionLocalTransforms.Init(FMatrix::Identity, NumSections);
+		}
+		SectionHierarchyDirty.Init(1, NumSections);
+		bSectionHierarchyLevelsDirty = true;
+		bSectionHierarchyDirty = true;
+		// The bakes aren't saved, the loaded sections settle again
+		SectionChangeFrames.Init(GFrameCounter, NumSections);
+		SectionBakes.Reset();
+		SectionBakes.SetNum(NumSections);
+		PendingSectionBakes.Reset();
+		// The sections may have other meshes now, the BVHs are built again and a running refit is dropped
+		SectionBVHs.Reset();
+		SectionBVHsDirty.Init(1, NumSections);
+		PendingBVHRefitTask.Reset();
+		PendingBVHRefits.Reset();
+	}
 }
 
-void UDeformMeshComponent::UpdateMeshSectionTransform(int32 SectionIndex, const FTransform& Transform)
+void UDeformMeshComponent::OnRegister()
 {
-	if (SectionIndex < DeformMeshSections.Num())
+	Super::OnRegister();
+
+	if (Assembly && SectionMeshes.Num() == 0)
 	{
-		//Set game thread state
-		const FMatrix TransformMatrix = Transform.ToMatrixWithScale().GetTransposed();
-		DeformMeshSections[SectionIndex].DeformTransform = TransformMatrix;
+		InitFromAssembly(Assembly);
+	}
 
-		DeformMeshSections[SectionIndex].SectionLocalBox += DeformMeshSections[SectionIndex].StaticMesh->
-			GetBoundingBox().TransformBy(Transform);
+	UpdateComponentTick();
 
+	if (UWorld* World = GetWorld())
+	{
+		if (UDeformFieldSubsystem* FieldSubsystem = World->GetSubsystem<UDeformFieldSubsystem>())
+		{
+			FieldSubsystem->RegisterComponent(this);
+		}
 
-		if (SceneProxy)
+		if (bUseUpdateBudget)
 		{
-			// Enqueue command to modify render thread info
-			FDeformMeshSceneProxy* DeformMeshSceneProxy = (FDeformMeshSceneProxy*)SceneProxy;
-			ENQUEUE_RENDER_COMMAND(FDeformMeshTransformsUpdate)(
-				[DeformMeshSceneProxy, SectionIndex, TransformMatrix](FRHICommandListImmediate& RHICmdList)
-				{
-					DeformMeshSceneProxy->UpdateDeformTransform_RenderThread(SectionIndex, TransformMatrix);
-				});
+			if (UDeformMeshBudgetSubsystem* BudgetSubsystem = World->GetSubsystem<UDeformMeshBudgetSubsystem>())
+			{
+				BudgetSubsystem->RegisterComponent(this);
+			}
 		}
-		UpdateLocalBounds(); // Update overall bounds
-		MarkRenderTransformDirty(); // Need to send new bounds to render thread
 	}
 }
 
-void UDeformMeshComponent::FinishTransformsUpdate()
+void UDeformMeshComponent::OnUnregister()
 {
-	if (SceneProxy)
+	if (UWorld* World = GetWorld())
 	{
-		// Enqueue command to modify render thread info
+		if (UDeformFieldSubsystem* FieldSubsystem = World->GetSubsystem<UDeformFieldSubsystem>())
+		{
+			FieldSubsystem->UnregisterComponent(this);
+		}
+
+		if (UDeformMeshBudgetSubsystem* BudgetSubsystem = World->GetSubsystem<UDeformMeshBudgetSubsystem>())
+		{
+			BudgetSubsystem->UnregisterComponent(this);
+		}
+	}
+	// The scene proxy is recreated from the game thread state, nothing left to send
+	PendingTransformUpdates.Reset();
+	PendingTransformUpdateIndices.Reset();
+	bTransformsUpdatePending = false;
+	// The finished bakes are kept for the next scene proxy, the running ones are dropped
+	PendingSectionBakes.Reset();
+
+	Super::OnUnregister();
+}
+
+void UDeformMeshComponent::TickComponent(float DeltaTime, ELevelTick TickType, FActorComponentTickFunction* ThisTickFunction)
+{
+	Super::TickComponent(DeltaTime, TickType, ThisTickFunction);
+
+	if (bBakeSettledSections)
+	{
+		UpdateSectionBakes();
+	}
+
+	if (SceneProxy && bReleaseHiddenSections)
+	{
+		// Enqueue command to evict the sections that weren't drawn for too long on the render thread
 		FDeformMeshSceneProxy* DeformMeshSceneProxy = (FDeformMeshSceneProxy*)SceneProxy;
-		ENQUEUE_RENDER_COMMAND(FDeformMeshAllTransformsSBUpdate)(
-			[DeformMeshSceneProxy](FRHICommandListImmediate& RHICmdList)
+		const float WorldTime = GetWorld()->GetTimeSeconds();
+		ENQUEUE_RENDER_COMMAND(FDeformMeshUpdateResidency)(
+			[DeformMeshSceneProxy, WorldTime](FRHICommandListImmediate& RHICmdList)
 			{
-				DeformMeshSceneProxy->UpdateDeformTransformsSB_RenderThread();
+				DeformMeshSceneProxy->UpdateResidency_RenderThread(WorldTime);
 			});
 	}
 }
 
-void UDeformMeshComponent::ClearMeshSection(int32 SectionIndex)
+void UDeformMeshComponent::OnUpdateTransform(EUpdateTransformFlags UpdateTransformFlags, ETeleportType Teleport)
 {
-	if (SectionIndex < DeformMeshSections.Num())
+	Super::OnUpdateTransform(UpdateTransformFlags, Teleport);
+
+	// Moving the component changes the fields that overlap it, and the deformation which depends on the world position
+	MarkDeformFieldsDirty();
+	for (int32 SectionIdx = 0; SectionIdx < SectionChangeFrames.Num(); SectionIdx++)
 	{
-		DeformMeshSections[SectionIndex].Reset();
-		UpdateLocalBounds();
-		MarkRenderStateDirty();
+		MarkSectionChanged(SectionIdx);
 	}
 }
 
-void UDeformMeshComponent::ClearAllMeshSections()
+void UDeformMeshComponent::MarkSectionChanged(int32 DenseIndex)
 {
-	DeformMeshSections.Empty();
-	UpdateLocalBounds();
-	MarkRenderStateDirty();
+	SectionChangeFrames[DenseIndex] = GFrameCounter;
+	SectionBVHsDirty[DenseIndex] = 1;
+	if (SectionBakes[DenseIndex].IsValid())
+	{
+		SectionBakes[DenseIndex].Reset();
+		MarkSectionBakeDirty(DenseIndex);
+	}
 }
 
-void UDeformMeshComponent::SetMeshSectionVisible(int32 SectionIndex, bool bNewVisibility)
+void UDeformMeshComponent::MarkSectionBakeDirty(int32 DenseIndex)
+{
+	// The bakes swapped during the frame are sent together by SendRenderDynamicData_Concurrent
+	// The static draws are cached by the scene, the transform update makes it gather them again without recreating the scene proxy
+	ChangedSectionBakes.Add(DenseSectionSlots[DenseIndex]);
+	MarkRenderDynamicDataDirty();
+	MarkRenderTransformDirty();
+}
+
+void UDeformMeshComponent::SendRenderDynamicData_Concurrent()
 {
-	if (SectionIndex < DeformMeshSections.Num())
+	Super::SendRenderDynamicData_Concurrent();
+
+	if (SceneProxy && ChangedSectionBakes.Num() > 0)
 	{
-		// Set game thread state
-		DeformMeshSections[SectionIndex].bSectionVisible = bNewVisibility;
+		// Resolve the packed index of the sections now, some of them may have been cleared since their swap
+		TArray<TPair<int32, TSharedPtr<FDeformMeshBakedSection, ESPMode::ThreadSafe>>> Bakes;
+		Bakes.Reserve(ChangedSectionBakes.Num());
+		for (const int32 SectionIndex : ChangedSectionBakes)
+		{
+			const int32 DenseIndex = GetDenseSectionIndex(SectionIndex);
+			if (DenseIndex != INDEX_NONE)
+			{
+				Bakes.Emplace(DenseIndex, SectionBakes[DenseIndex]);
+			}
+		}
 
-		if (SceneProxy)
+		// Enqueue command to swap the bakes on the render thread
+		FDeformMeshSceneProxy* DeformMeshSceneProxy = (FDeformMeshSceneProxy*)SceneProxy;
+		ENQUEUE_RENDER_COMMAND(FDeformMeshSectionBakesUpdate)(
+			[DeformMeshSceneProxy, Bakes = MoveTemp(Bakes)](FRHICommandListImmediate& RHICmdList)
+			{
+				DeformMeshSceneProxy->UpdateSectionBakes_RenderThread(Bakes);
+			});
+	}
+	ChangedSectionBakes.Reset();
+}
+
+void UDeformMeshComponent::UpdateSectionBakes()
+{
+	const uint64 FrameCounter = GFrameCounter;
+	const ERHIFeatureLevel::Type FeatureLevel = GetScene() ? GetScene()->GetFeatureLevel() : GMaxRHIFeatureLevel;
+
+	// Swap in the finished bakes, unless their section changed while they ran
+	for (int32 BakeIdx = PendingSectionBakes.Num() - 1; BakeIdx >= 0; BakeIdx--)
+	{
+		FPendingSectionBake& PendingBake = PendingSectionBakes[BakeIdx];
+		if (!PendingBake.Positions.IsReady())
 		{
-			// Enqueue command to modify render thread info
-			FDeformMeshSceneProxy* DeformMeshSceneProxy = (FDeformMeshSceneProxy*)SceneProxy;
-			ENQUEUE_RENDER_COMMAND(FDeformMeshSectionVisibilityUpdate)(
-				[DeformMeshSceneProxy, SectionIndex, bNewVisibility](FRHICommandListImmediate& RHICmdList)
-				{
-					DeformMeshSceneProxy->SetSectionVisibility_RenderThread(SectionIndex, bNewVisibility);
-				});
+			continue;
+		}
+
+		const int32 DenseIndex = GetDenseSectionIndex(PendingBake.SectionIndex);
+		if (DenseIndex != INDEX_NONE && SectionChangeFrames[DenseIndex] == PendingBake.ChangeFrame)
+		{
+			//We're assuming that there's only one LOD
+			FStaticMeshVertexBuffers* VertexBuffers = &SectionMeshes[DenseIndex]->GetRenderData()->LODResources[0].VertexBuffers;
+			SectionBakes[DenseIndex] = FDeformMeshBakedSection::Create(FeatureLevel, PendingBake.DeformTransform, CopyTemp(PendingBake.Positions.Get()), VertexBuffers);
+			MarkSectionBakeDirty(DenseIndex);
+		}
+		PendingSectionBakes.RemoveAtSwap(BakeIdx, 1, false);
+	}
+
+	// The render thread keeps moving the sections until it reaches the last sample
+	const UWorld* World = GetWorld();
+	if (bInterpolateTransforms && World && World->GetTimeSeconds() - LastTransformSampleTime < 2.f / TransformSampleRate)
+	{
+		return;
+	}
+
+	const FMatrix LocalToWorld = GetComponentTransform().ToMatrixWithScale();
+	for (TConstSetBitIterator<> VisibleIt(SectionVisibility); VisibleIt; ++VisibleIt)
+	{
+		const int32 DenseIndex = VisibleIt.GetIndex();
+		const int32 SectionIndex = DenseSectionSlots[DenseIndex];
+		if (SectionBakes[DenseIndex].IsValid() || FrameCounter - SectionChangeFrames[DenseIndex] < (uint64)SettledFramesToBake
+			|| PendingSectionBakes.ContainsByPredicate([SectionIndex](const FPendingSectionBake& PendingBake) { return PendingBake.SectionIndex == SectionIndex; }))
+		{
+			continue;
+		}
+
+		const UStaticMesh* StaticMesh = SectionMeshes[DenseIndex];
+		if (StaticMesh == nullptr || StaticMesh->GetRenderData() == nullptr)
+		{
+			continue;
+		}
+		//Cooked meshes only keep their vertices on the CPU if they allow CPU access
+		const FPositionVertexBuffer& PositionBuffer = StaticMesh->GetRenderData()->LODResources[0].VertexBuffers.PositionVertexBuffer;
+		if (PositionBuffer.GetVertexData() == nullptr)
+		{
+			continue;
 		}
+
+		// The worker gets its own copy of everything, the section can change or go away while it runs
+		TArray<FVector> Positions;
+		Positions.SetNumUninitialized(PositionBuffer.GetNumVertices());
+		FMemory::Memcpy(Positions.GetData(), PositionBuffer.GetVertexData(), Positions.Num() * sizeof(FVector));
+		const FIntPoint FieldRange = DeformFieldRanges.IsValidIndex(DenseIndex) ? DeformFieldRanges[DenseIndex] : FIntPoint::ZeroValue;
+		TArray<FDeformMeshFieldGPU> Fields(DeformFields.GetData() + FieldRange.X, FieldRange.Y);
+		const FMatrix DeformTransform = SectionDeformTransforms[DenseIndex];
+
+		PendingSectionBakes.Add({SectionIndex, SectionChangeFrames[DenseIndex], DeformTransform,
+			Async(EAsyncExecution::ThreadPool, [Positions = MoveTemp(Positions), LocalToWorld, DeformTransform, Fields = MoveTemp(Fields)]() mutable
+			{
+				return FDeformMeshBakedSection::BakePositions(MoveTemp(Positions), LocalToWorld, DeformTransform, Fields);
+			})});
 	}
 }
 
-bool UDeformMeshComponent::IsMeshSectionVisible(int32 SectionIndex) const
+void UDeformMeshComponent::UpdateComponentTick()
 {
-	return (SectionIndex < DeformMeshSections.Num()) ? DeformMeshSections[SectionIndex].bSectionVisible : false;
+	SetComponentTickEnabled(bReleaseHiddenSections || bBakeSettledSections);
 }
 
-int32 UDeformMeshComponent::GetNumSections() const
+void UDeformMeshComponent::ResetSectionBVH(int32 DenseIndex)
+{
+	// The topology may have changed, the BVH will be rebuilt on the next query
+	// A running refit may still hand back the BVH of the previous mesh, it's done before the reset
+	FinishSectionBVHRefit();
+	if (SectionBVHs.IsValidIndex(DenseIndex))
+	{
+		SectionBVHs[DenseIndex].Reset();
+	}
+	SectionBVHsDirty[DenseIndex] = 1;
+}
+
+int32 UDeformMeshComponent::GetDenseSectionIndex(int32 SectionIndex) const
+{
+	return SectionSlots.IsValidIndex(SectionIndex) ? SectionSlots[SectionIndex].DenseIndex : INDEX_NONE;
+}
+
+int32 UDeformMeshComponent::AllocateSectionSlot(int32 SectionIndex)
 {
-	return DeformMeshSections.Num();
+	// Grow the slot table, the slots in between are free
+	while (SectionSlots.Num() <= SectionIndex)
+	{
+		FreeSectionSlots.Add(SectionSlots.Add(FDeformMeshSectionSlot()));
+	}
+
+	FDeformMeshSectionSlot& Slot = SectionSlots[SectionIndex];
+	if (Slot.DenseIndex == INDEX_NONE)
+	{
+		FreeSectionSlots.RemoveSingleSwap(SectionIndex, false);
+		Slot.DenseIndex = SectionMeshes.Add(nullptr);
+		SectionDeformTransforms.Add(FMatrix::Identity);
+		SectionLocalBoxes.Add(FBox(ForceInit));
+		SectionVisibility.Add(true);
+		SectionParents.Add(INDEX_NONE);
+		SectionLocalTransforms.Add(FMatrix::Identity);
+		SectionHierarchyDirty.Add(0);
+		SectionDerivedData.AddDefaulted();
+		SectionChangeFrames.Add(GFrameCounter);
+		SectionBVHsDirty.Add(1);
+		SectionBakes.AddDefaulted();
+		DenseSectionSlots.Add(SectionIndex);
+		SectionBVHs.SetNum(SectionMeshes.Num());
+	}
+
+	// Handles to the previous section at this index are now stale
+	Slot.Generation++;
+	return Slot.DenseIndex;
 }
 
-FDeformMeshSection* UDeformMeshComponent::GetDeformMeshSection(int32 SectionIndex)
+void UDeformMeshComponent::ReleaseSectionSlot(int32 SectionIndex)
 {
-	if (SectionIndex < DeformMeshSections.Num())
+	const int32 DenseIndex = GetDenseSectionIndex(SectionIndex);
+	if (DenseIndex == INDEX_NONE)
+	{
+		return;
+	}
+
+	// Swap the last section in the hole, so the packed arrays stay packed
+	const int32 LastDenseIndex = SectionMeshes.Num() - 1;
+	SectionMeshes.RemoveAtSwap(DenseIndex, 1, false);
+	SectionDeformTransforms.RemoveAtSwap(DenseIndex, 1, false);
+	SectionLocalBoxes.RemoveAtSwap(DenseIndex, 1, false);
+	SectionVisibility[DenseIndex] = (bool)SectionVisibility[LastDenseIndex];
+	SectionVisibility.RemoveAt(LastDenseIndex);
+	SectionParents.RemoveAtSwap(DenseIndex, 1, false);
+	SectionLocalTransforms.RemoveAtSwap(DenseIndex, 1, false);
+	SectionHierarchyDirty.RemoveAtSwap(DenseIndex, 1, false);
+	SectionDerivedData.RemoveAtSwap(DenseIndex, 1, false);
+	SectionChangeFrames.RemoveAtSwap(DenseIndex, 1, false);
+	SectionBVHsDirty.RemoveAtSwap(DenseIndex, 1, false);
+	SectionBakes.RemoveAtSwap(DenseIndex, 1, false);
+	PendingSectionBakes.RemoveAllSwap([SectionIndex](const FPendingSectionBake& PendingBake) { return PendingBake.SectionIndex == SectionIndex; });
+	DenseSectionSlots.RemoveAtSwap(DenseIndex, 1, false);
+	SectionBVHs.RemoveAtSwap(DenseIndex, 1, false);
+	if (DeformFieldRanges.Num() == LastDenseIndex + 1)
 	{
-		return &DeformMeshSections[SectionIndex];
+		DeformFieldRanges.RemoveAtSwap(DenseIndex, 1, false);
 	}
 	else
 	{
-		return nullptr;
+		// The field subsystem will assign the fields again
+		DeformFieldRanges.Reset();
+	}
+
+	if (DenseIndex != LastDenseIndex)
+	{
+		SectionSlots[DenseSectionSlots[DenseIndex]].DenseIndex = DenseIndex;
+	}
+
+	FDeformMeshSectionSlot& Slot = SectionSlots[SectionIndex];
+	Slot.DenseIndex = INDEX_NONE;
+	Slot.Generation++;
+	FreeSectionSlots.Add(SectionIndex);
+
+	// The children become roots, they keep their last deform transform
+	for (int32& Parent : SectionParents)
+	{
+		if (Parent == SectionIndex)
+		{
+			Parent = INDEX_NONE;
+		}
 	}
+	bSectionHierarchyLevelsDirty = true;
 }
 
-void UDeformMeshComponent::SetDeformMeshSection(int32 SectionIndex, const FDeformMeshSection& Section)
+void UDeformMeshComponent::MigrateDeformMeshSections()
 {
-	// Ensure sections array is long enough
-	if (SectionIndex >= DeformMeshSections.Num())
+	for (int32 SectionIndex = 0; SectionIndex < DeformMeshSections.Num(); SectionIndex++)
 	{
-		DeformMeshSections.SetNum(SectionIndex + 1, false);
+		// The cleared sections were kept as empty entries, their index goes in the free list
+		const FDeformMeshSection& Section = DeformMeshSections[SectionIndex];
+		if (Section.StaticMesh == nullptr)
+		{
+			continue;
+		}
+
+		const int32 DenseIndex = AllocateSectionSlot(SectionIndex);
+		SectionMeshes[DenseIndex] = Section.StaticMesh;
+		SectionDeformTransforms[DenseIndex] = Section.DeformTransform;
+		SectionLocalBoxes[DenseIndex] = Section.SectionLocalBox;
+		SectionVisibility[DenseIndex] = Section.bSectionVisible;
 	}
+	DeformMeshSections.Empty();
+	bSectionHierarchyLevelsDirty = true;
+}
+
+FDeformMeshSectionHandle UDeformMeshComponent::CreateMeshSection(int32 SectionIndex, UStaticMesh* Mesh, const FTransform& Transform)
+{
+	// Get the section at this index, or a new one
+	const int32 DenseIndex = AllocateSectionSlot(SectionIndex);
+
+	// Fill in the mesh section with the needed data, this resets it in case it already existed
+	// I'm assuming that the StaticMesh has only one section and I'm only using that
+	SectionMeshes[DenseIndex] = Mesh;
+	SectionDeformTransforms[DenseIndex] = Transform.ToMatrixWithScale().GetTransposed();
+	SectionVisibility[DenseIndex] = true;
+	SectionParents[DenseIndex] = INDEX_NONE;
+	SectionLocalTransforms[DenseIndex] = FMatrix::Identity;
+	bSectionHierarchyLevelsDirty = true;
+	SectionDerivedData[DenseIndex] = FDeformMeshDerivedData::Get(Mesh, GetDerivedDataFlags());
+	MarkSectionChanged(DenseIndex);
+
+	//Update the local bound using the bounds of the static mesh that we're adding
+	//I'm not taking in consideration the deformation here, if the deformation cause the mesh to go outside its bounds
+	Mesh->CalculateExtendedBounds();
+	SectionLocalBoxes[DenseIndex] = Mesh->GetBoundingBox();
+
+	//Add this sections' material to the list of the component's materials, with the same index as the section
+	SetMaterial(SectionIndex, Mesh->GetMaterial(0));
 
-	DeformMeshSections[SectionIndex] = Section;
+	ResetSectionBVH(DenseIndex);
+	UpdateReplicatedSection(SectionIndex, &Transform);
 
 	UpdateLocalBounds(); // Update overall bounds
 	MarkRenderStateDirty(); // New section requires recreating scene proxy
+
+	return GetSectionHandle(SectionIndex);
 }
 
-FPrimitiveSceneProxy* UDeformMeshComponent::CreateSceneProxy()
+FDeformMeshSectionHandle UDeformMeshComponent::AddMeshSection(UStaticMesh* Mesh, const FTransform& Transform)
+{
+	const int32 SectionIndex = FreeSectionSlots.Num() > 0 ? FreeSectionSlots.Last() : SectionSlots.Num();
+	return CreateMeshSection(SectionIndex, Mesh, Transform);
+}
+
+void UDeformMeshComponent::UpdateMeshSectionTransform(int32 SectionIndex, const FTransform& Transform)
+{
+	const int32 DenseIndex = GetDenseSectionIndex(SectionIndex);
+	if (DenseIndex != INDEX_NONE)
+	{
+		// The same transform sent again, like the samples of a section that stopped moving, changes nothing and lets the section settle
+		const FMatrix DeformTransform = Transform.ToMatrixWithScale().GetTransposed();
+		const TArray<FMatrix>& Transforms = SectionParents[DenseIndex] != INDEX_NONE ? SectionLocalTransforms : SectionDeformTransforms;
+		if (Transforms[DenseIndex].Equals(DeformTransform, 0.f))
+		{
+			return;
+		}
+
+		// The children are composed with their parent in UpdateSectionHierarchy
+		SectionHierarchyDirty[DenseIndex] = 1;
+		bSectionHierarchyDirty = true;
+		if (SectionParents[DenseIndex] != INDEX_NONE)
+		{
+			SectionLocalTransforms[DenseIndex] = DeformTransform;
+			return;
+		}
+
+		//Set game thread state
+		SectionDeformTransforms[DenseIndex] = DeformTransform;
+		SectionLocalBoxes[DenseIndex] = SectionMeshes[DenseIndex]->GetBoundingBox().TransformBy(Transform);
+		UpdateReplicatedSection(SectionIndex, &Transform);
+
+		// The render thread gets all the updates at once in FinishTransformsUpdate, and so do the overall bounds
+		QueueTransformUpdate(SectionIndex, SectionDeformTransforms[DenseIndex]);
+		bLocalBoundsDirty = true;
+	}
+}
+
+void UDeformMeshComponent::QueueTransformUpdate(int32 SectionIndex, const FMatrix& DeformTransform)
 {
+	// A baked section set to the transform it was baked with doesn't need to go back to the deformed draw, its BVH is refit all the same
+	const int32 DenseIndex = GetDenseSectionIndex(SectionIndex);
+	if (DenseIndex != INDEX_NONE)
+	{
+		SectionBVHsDirty[DenseIndex] = 1;
+	}
+	if (DenseIndex != INDEX_NONE && !(SectionBakes[DenseIndex].IsValid() && SectionBakes[DenseIndex]->GetDeformTransform().Equals(DeformTransform, 0.f)))
+	{
+		MarkSectionChanged(DenseIndex);
+	}
+
 	if (!SceneProxy)
-		return new FDeformMeshSceneProxy(this);
+	{
+		return;
+	}
+
+	if (const int32* PendingIndex = PendingTransformUpdateIndices.Find(SectionIndex))
+	{
+		PendingTransformUpdates[*PendingIndex].DeformTransform = DeformTransform;
+	}
 	else
-		return SceneProxy;
+	{
+		PendingTransformUpdateIndices.Add(SectionIndex, PendingTransformUpdates.Emplace(SectionIndex, DeformTransform));
+	}
 }
 
-int32 UDeformMeshComponent::GetNumMaterials() const
+bool UDeformMeshComponent::SetMeshSectionParent(int32 SectionIndex, int32 ParentSectionIndex)
+{
+	const int32 DenseIndex = GetDenseSectionIndex(SectionIndex);
+	if (DenseIndex == INDEX_NONE || (ParentSectionIndex != INDEX_NONE && GetDenseSectionIndex(ParentSectionIndex) == INDEX_NONE))
+	{
+		return false;
+	}
+
+	// Refuse cycles, the parent can't be the section or one of its descendants
+	for (int32 Ancestor = ParentSectionIndex; Ancestor != INDEX_NONE; Ancestor = SectionParents[GetDenseSectionIndex(Ancestor)])
+	{
+		if (Ancestor == SectionIndex)
+		{
+			return false;
+		}
+	}
+
+	if (SectionParents[DenseIndex] != ParentSectionIndex)
+	{
+		// A root section's transform becomes its transform relative to the parent
+		if (SectionParents[DenseIndex] == INDEX_NONE)
+		{
+			SectionLocalTransforms[DenseIndex] = SectionDeformTransforms[DenseIndex];
+		}
+		SectionParents[DenseIndex] = ParentSectionIndex;
+		SectionHierarchyDirty[DenseIndex] = 1;
+		bSectionHierarchyLevelsDirty = true;
+		bSectionHierarchyDirty = true;
+	}
+	return true;
+}
+
+int32 UDeformMeshComponent::GetMeshSectionParent(int32 SectionIndex) const
+{
+	const int32 DenseIndex = GetDenseSectionIndex(SectionIndex);
+	return DenseIndex != INDEX_NONE ? SectionParents[DenseIndex] : INDEX_NONE;
+}
+
+void UDeformMeshComponent::RebuildSectionHierarchyLevels()
+{
+	bSectionHierarchyLevelsDirty = false;
+	SectionHierarchyLevels.Reset();
+
+	// Depth of each packed section, the roots are at depth 0 and aren't stored in the levels
+	const int32 NumSections = SectionParents.Num();
+	TArray<int32> Depths;
+	Depths.Init(INDEX_NONE, NumSections);
+	TArray<int32, TInlineAllocator<32>> Chain;
+	for (int32 SectionIdx = 0; SectionIdx < NumSections; SectionIdx++)
+	{
+		// Walk up to the first section with a known depth, then assign the depths on the way back down
+		int32 Current = SectionIdx;
+		while (Depths[Current] == INDEX_NONE)
+		{
+			const int32 ParentDense = GetDenseSectionIndex(SectionParents[Current]);
+			if (ParentDense == INDEX_NONE)
+			{
+				Depths[Current] = 0;
+				break;
+			}
+			Chain.Add(Current);
+			Current = ParentDense;
+		}
+
+		while (Chain.Num() > 0)
+		{
+			const int32 Child = Chain.Pop(false);
+			const int32 ParentDense = GetDenseSectionIndex(SectionParents[Child]);
+			Depths[Child] = Depths[ParentDense] + 1;
+			if (SectionHierarchyLevels.Num() < Depths[Child])
+			{
+				SectionHierarchyLevels.SetNum(Depths[Child]);
+			}
+			SectionHierarchyLevels[Depths[Child] - 1].Emplace(Child, ParentDense);
+		}
+	}
+}
+
+void UDeformMeshComponent::UpdateSectionHierarchy()
 {
-	return DeformMeshSections.Num();
+	if (!bSectionHierarchyDirty)
+	{
+		return;
+	}
+	SCOPE_CYCLE_COUNTER(STAT_DeformMesh_UpdateHierarchy);
+	bSectionHierarchyDirty = false;
+
+	if (bSectionHierarchyLevelsDirty)
+	{
+		RebuildSectionHierarchyLevels();
+	}
+
+	// The levels are evaluated one after the other, the sections of a level in parallel
+	// The deform transforms are stored transposed, so the child is Parent * Local instead of Local * Parent
+	for (const TArray<FIntPoint>& Level : SectionHierarchyLevels)
+	{
+		ParallelFor(Level.Num(), [this, &Level](int32 LevelIdx)
+		{
+			const FIntPoint& Entry = Level[LevelIdx];
+			if (SectionHierarchyDirty[Entry.X] | SectionHierarchyDirty[Entry.Y])
+			{
+				// A child that ends up where it was isn't queued, and neither are its own children unless they moved
+				const FMatrix DeformTransform = SectionDeformTransforms[Entry.Y] * SectionLocalTransforms[Entry.X];
+				SectionHierarchyDirty[Entry.X] = !SectionDeformTransforms[Entry.X].Equals(DeformTransform, 0.f);
+				if (SectionHierarchyDirty[Entry.X])
+				{
+					SectionDeformTransforms[Entry.X] = DeformTransform;
+					SectionLocalBoxes[Entry.X] = SectionMeshes[Entry.X]->GetBoundingBox().TransformBy(DeformTransform.GetTransposed());
+				}
+			}
+		}, Level.Num() < 256 ? EParallelForFlags::ForceSingleThread : EParallelForFlags::None);
+	}
+
+	// Queue the moved children for the render thread, the roots queued themselves
+	const bool bReplicate = GetIsReplicated() && GetOwnerRole() == ROLE_Authority;
+	bool bChildrenMoved = false;
+	for (int32 SectionIdx = 0; SectionIdx < SectionHierarchyDirty.Num(); SectionIdx++)
+	{
+		if (SectionHierarchyDirty[SectionIdx] && SectionParents[SectionIdx] != INDEX_NONE)
+		{
+			bChildrenMoved = true;
+			QueueTransformUpdate(DenseSectionSlots[SectionIdx], SectionDeformTransforms[SectionIdx]);
+			if (bReplicate)
+			{
+				const FTransform Transform(SectionDeformTransforms[SectionIdx].GetTransposed());
+				UpdateReplicatedSection(DenseSectionSlots[SectionIdx], &Transform);
+			}
+		}
+	}
+	FMemory::Memzero(SectionHierarchyDirty.GetData(), SectionHierarchyDirty.Num());
+
+	if (bChildrenMoved)
+	{
+		bLocalBoundsDirty = true;
+	}
 }
+
+void UDeformMeshComponent::FinishTransformsUpdate()
+{
+	UpdateSectionHierarchy();
+
+	// The overall bounds of all the sections moved since the last call, in one pass over the sections
+	if (bLocalBoundsDirty)
+	{
+		UpdateLocalBounds();
+	}
+
+	// Refit the BVHs of the moved sections on a worker while the frame goes on, once something queries them
+	if (bSectionBVHsQueried)
+	{
+		StartSectionBVHRefit();
+	}
+
+	// The updates are a sample of this time, even if the budget sends them later
+	const UWorld* World = GetWorld();
+	LastTransformSampleTime = World ? World->GetTimeSeconds() : 0.f;
+
+	// The budget subsystem sends the updates when this component's turn comes
+	if (bUseUpdateBudget && IsRegistered())
+	{
+		bTransformsUpdatePending = true;
+		return;
+	}
+
+	SendTransformsUpdate();
+}
+
+void UDeformMeshComponent::SendTransformsUpdate()
+{
+	bTransformsUpdatePending = false;
+	PendingTransformUpdateIndices.Reset();
+
+	const float SampleTime = LastTransformSampleTime;
+
+	// Resolve the packed index of the sections now, some of them may have been cleared since their update
+	TArray<FDeformMeshTransformUpdate> Updates = MoveTemp(PendingTransformUpdates);
+	for (FDeformMeshTransformUpdate& Update : Updates)
+	{
+		Update.Index = GetDenseSectionIndex(Update.Index);
+	}
+	Updates.RemoveAll([](const FDeformMeshTransformUpdate& Update) { return Update.Index == INDEX_NONE; });
+
+	if (SceneProxy)
+	{
+		// Enqueue command to modify render thread info
+		FDeformMeshSceneProxy* DeformMeshSceneProxy = (FDeformMeshSceneProxy*)SceneProxy;
+		ENQUEUE_RENDER_COMMAND(FDeformMeshAllTransformsSBUpdate)(
+			[DeformMeshSceneProxy, Updates = MoveTemp(Updates), SampleTime](FRHICommandListImmediate& RHICmdList)
+			{
+				DeformMeshSceneProxy->UpdateDeformTransforms_RenderThread(Updates, SampleTime);
+			});
+	}
+}
+
+int32 UDeformMeshComponent::GetNumPendingTransformUpdates() const
+{
+	return PendingTransformUpdates.Num();
+}
+
+int32 UDeformMeshComponent::GetTransformsUploadSize() const
+{
+	// The render thread uploads the whole transform buffer
+	return SceneProxy ? SectionDeformTransforms.Num() * (int32)sizeof(FMatrix) : 0;
+}
+
+bool UDeformMeshComponent::HasPendingTransformsUpdate() const
+{
+	return bTransformsUpdatePending;
+}
+
+void UDeformMeshComponent::SetUseUpdateBudget(bool bEnable)
+{
+	if (bUseUpdateBudget == bEnable)
+	{
+		return;
+	}
+	bUseUpdateBudget = bEnable;
+
+	if (UWorld* World = GetWorld())
+	{
+		if (UDeformMeshBudgetSubsystem* BudgetSubsystem = World->GetSubsystem<UDeformMeshBudgetSubsystem>())
+		{
+			if (bEnable && IsRegistered())
+			{
+				BudgetSubsystem->RegisterComponent(this);
+			}
+			else
+			{
+				BudgetSubsystem->UnregisterComponent(this);
+			}
+		}
+	}
+
+	// Don't leave the updates deferred by the budget behind
+	if (!bEnable && bTransformsUpdatePending)
+	{
+		SendTransformsUpdate();
+	}
+}
+
+void UDeformMeshComponent::RefreshSectionDerivedData()
+{
+	const EDeformMeshDerivedDataFlags Flags = GetDerivedDataFlags();
+	SectionDerivedData.SetNum(SectionMeshes.Num());
+	for (int32 SectionIdx = 0; SectionIdx < SectionMeshes.Num(); SectionIdx++)
+	{
+		const TSharedPtr<FDeformMeshDerivedData, ESPMode::ThreadSafe>& DerivedData = SectionDerivedData[SectionIdx];
+		if (!DerivedData.IsValid() || !DerivedData->HasBuilt(Flags))
+		{
+			SectionDerivedData[SectionIdx] = FDeformMeshDerivedData::Get(SectionMeshes[SectionIdx], Flags);
+		}
+	}
+}
+
+EDeformMeshDerivedDataFlags UDeformMeshComponent::GetDerivedDataFlags() const
+{
+	EDeformMeshDerivedDataFlags Flags = EDeformMeshDerivedDataFlags::None;
+	if (bQuantizePositions)
+	{
+		Flags |= EDeformMeshDerivedDataFlags::QuantizedPositions;
+	}
+	if (bOptimizeIndexOrder)
+	{
+		Flags |= EDeformMeshDerivedDataFlags::OptimizedIndices;
+	}
+	if (bSplitDeformClusters)
+	{
+		Flags |= EDeformMeshDerivedDataFlags::Clusters;
+	}
+	return Flags;
+}
+
+void UDeformMeshComponent::SetQuantizePositions(bool bEnable)
+{
+	bQuantizePositions = bEnable;
+	// The scene proxy binds the position stream when created, and gets the missing derived data then
+	MarkRenderStateDirty();
+}
+
+void UDeformMeshComponent::SetOptimizeIndexOrder(bool bEnable)
+{
+	bOptimizeIndexOrder = bEnable;
+	// The scene proxy copies the indices when created
+	MarkRenderStateDirty();
+}
+
+void UDeformMeshComponent::SetSplitDeformClusters(bool bEnable)
+{
+	bSplitDeformClusters = bEnable;
+	// The scene proxy copies the clustered indices when created
+	MarkRenderStateDirty();
+}
+
+void UDeformMeshComponent::SetSectionResidencyPolicy(bool bEnable, float EvictionDelay, int32 MemoryBudget)
+{
+	bReleaseHiddenSections = bEnable;
+	SectionEvictionDelay = FMath::Max(EvictionDelay, 0.f);
+	SectionMemoryBudget = FMath::Max(MemoryBudget, 0);
+	UpdateComponentTick();
+	// The scene proxy reads the residency settings when created
+	MarkRenderStateDirty();
+}
+
+void UDeformMeshComponent::SetBakeSettledSections(bool bEnable, int32 SettledFrames)
+{
+	bBakeSettledSections = bEnable;
+	SettledFramesToBake = FMath::Max(SettledFrames, 1);
+	UpdateComponentTick();
+
+	if (!bEnable)
+	{
+		PendingSectionBakes.Reset();
+		bool bHadBakes = false;
+		for (TSharedPtr<FDeformMeshBakedSection, ESPMode::ThreadSafe>& Bake : SectionBakes)
+		{
+			bHadBakes |= Bake.IsValid();
+			Bake.Reset();
+		}
+		// The baked sections are drawn deformed again by a new scene proxy
+		if (bHadBakes)
+		{
+			MarkRenderStateDirty();
+		}
+	}
+}
+
+bool UDeformMeshComponent::IsMeshSectionBaked(int32 SectionIndex) const
+{
+	const int32 DenseIndex = GetDenseSectionIndex(SectionIndex);
+	return DenseIndex != INDEX_NONE && SectionBakes[DenseIndex].IsValid();
+}
+
+void UDeformMeshComponent::SetTransformInterpolation(bool bEnable, float SampleRate)
+{
+	bInterpolateTransforms = bEnable;
+	TransformSampleRate = FMath::Max(SampleRate, 1.f);
+	// The scene proxy reads the interpolation settings when created
+	MarkRenderStateDirty();
+}
+
+bool UDeformMeshComponent::IsTransformSampleDue() const
+{
+	if (!bInterpolateTransforms)
+	{
+		return true;
+	}
+
+	const UWorld* World = GetWorld();
+	// Small tolerance so frame times that add up to the sample interval aren't rounded to the next frame
+	return !World || World->GetTimeSeconds() - LastTransformSampleTime >= 1.f / TransformSampleRate - 0.001f;
+}
+
+#if WITH_EDITOR
+void UDeformMeshComponent::CaptureToAssembly()
+{
+	if (Assembly == nullptr)
+	{
+		UE_LOG(LogDeformMesh, Warning, TEXT("%s has no assembly to capture its sections in"), *GetPathName());
+		return;
+	}
+
+	Assembly->Modify();
+	Assembly->CaptureComponent(this, GetDerivedDataFlags());
+}
+#endif
+
+void UDeformMeshComponent::InitFromAssembly(const UDeformMeshAssembly* InAssembly)
+{
+	ClearAllMeshSections();
+	if (InAssembly == nullptr)
+	{
+		return;
+	}
+
+	const TArray<FDeformMeshAssemblySection>& AssemblySections = InAssembly->GetSections();
+	const TArray<UStaticMesh*>& Meshes = InAssembly->GetMeshes();
+	const TArray<UMaterialInterface*>& Materials = InAssembly->GetMaterials();
+	const int32 NumSections = AssemblySections.Num();
+
+	// The derived data is looked up once per mesh, the assembly registered what it saved
+	const EDeformMeshDerivedDataFlags DerivedDataFlags = GetDerivedDataFlags();
+	TArray<TSharedPtr<FDeformMeshDerivedData, ESPMode::ThreadSafe>> MeshDerivedData;
+	MeshDerivedData.Reserve(Meshes.Num());
+	for (UStaticMesh* Mesh : Meshes)
+	{
+		MeshDerivedData.Add(FDeformMeshDerivedData::Get(Mesh, DerivedDataFlags));
+	}
+
+	SectionMeshes.Reserve(NumSections);
+	SectionDeformTransforms.Reserve(NumSections);
+	SectionLocalBoxes.Reserve(NumSections);
+	SectionVisibility.Reserve(NumSections);
+	SectionParents.Reserve(NumSections);
+	SectionLocalTransforms.Reserve(NumSections);
+	SectionDerivedData.Reserve(NumSections);
+	DenseSectionSlots.Reserve(NumSections);
+	for (const FDeformMeshAssemblySection& Section : AssemblySections)
+	{
+		// Grow the slot table, the slots in between are free
+		while (SectionSlots.Num() <= Section.SectionIndex)
+		{
+			SectionSlots.AddDefaulted();
+		}
+		FDeformMeshSectionSlot& Slot = SectionSlots[Section.SectionIndex];
+		Slot.DenseIndex = SectionMeshes.Add(Meshes[Section.MeshIndex]);
+		Slot.Generation++;
+
+		SectionDeformTransforms.Add(Section.DeformTransform);
+		SectionLocalBoxes.Add(Section.LocalBox);
+		SectionVisibility.Add(Section.bVisible);
+		SectionParents.Add(Section.ParentSectionIndex);
+		SectionLocalTransforms.Add(Section.LocalTransform);
+		SectionDerivedData.Add(MeshDerivedData[Section.MeshIndex]);
+		DenseSectionSlots.Add(Section.SectionIndex);
+
+		// Materials are indexed by section index
+		if (OverrideMaterials.Num() <= Section.SectionIndex)
+		{
+			OverrideMaterials.SetNum(Section.SectionIndex + 1);
+		}
+		OverrideMaterials[Section.SectionIndex] = Materials.IsValidIndex(Section.MaterialIndex) ? Materials[Section.MaterialIndex] : nullptr;
+	}
+
+	FreeSectionSlots.Reset();
+	for (int32 SectionIndex = 0; SectionIndex < SectionSlots.Num(); SectionIndex++)
+	{
+		if (SectionSlots[SectionIndex].DenseIndex == INDEX_NONE)
+		{
+			FreeSectionSlots.Add(SectionIndex);
+		}
+	}
+
+	SectionHierarchyDirty.Init(0, NumSections);
+	bSectionHierarchyLevelsDirty = true;
+	SectionChangeFrames.Init(GFrameCounter, NumSections);
+	SectionBakes.SetNum(NumSections);
+	SectionBVHs.SetNum(NumSections);
+	SectionBVHsDirty.Init(1, NumSections);
+
+	for (const FDeformMeshAssemblySection& Section : AssemblySections)
+	{
+		const FTransform Transform(Section.DeformTransform.GetTransposed());
+		UpdateReplicatedSection(Section.SectionIndex, &Transform);
+	}
+
+	UpdateLocalBounds(); // Update overall bounds
+	MarkRenderStateDirty(); // New sections require recreating scene proxy
+}
+
+void UDeformMeshComponent::ClearMeshSection(int32 SectionIndex)
+{
+	if (GetDenseSectionIndex(SectionIndex) != INDEX_NONE)
+	{
+		ReleaseSectionSlot(SectionIndex);
+		UpdateReplicatedSection(SectionIndex, nullptr);
+		UpdateLocalBounds();
+		MarkRenderStateDirty();
+	}
+}
+
+void UDeformMeshComponent::ClearAllMeshSections()
+{
+	// Keep the slot table so the handles of the cleared sections stay stale
+	for (const int32 SectionIndex : DenseSectionSlots)
+	{
+		FDeformMeshSectionSlot& Slot = SectionSlots[SectionIndex];
+		Slot.DenseIndex = INDEX_NONE;
+		Slot.Generation++;
+		FreeSectionSlots.Add(SectionIndex);
+	}
+
+	SectionMeshes.Empty();
+	SectionDeformTransforms.Empty();
+	SectionLocalBoxes.Empty();
+	SectionVisibility.Empty();
+	SectionParents.Empty();
+	SectionLocalTransforms.Empty();
+	SectionHierarchyDirty.Empty();
+	SectionHierarchyLevels.Empty();
+	SectionDerivedData.Empty();
+	SectionChangeFrames.Empty();
+	SectionBVHsDirty.Empty();
+	SectionBakes.Empty();
+	PendingSectionBakes.Empty();
+	DenseSectionSlots.Empty();
+	DeformFieldRanges.Empty();
+	SectionBVHs.Empty();
+	if (ReplicatedSections.Items.Num() > 0)
+	{
+		ReplicatedSections.Items.Empty();
+		ReplicatedSections.MarkArrayDirty();
+	}
+	UpdateLocalBounds();
+	MarkRenderStateDirty();
+}
+
+void UDeformMeshComponent::SetMeshSectionVisible(int32 SectionIndex, bool bNewVisibility)
+{
+	const int32 DenseIndex = GetDenseSectionIndex(SectionIndex);
+	if (DenseIndex != INDEX_NONE)
+	{
+		// Set game thread state
+		SectionVisibility[DenseIndex] = bNewVisibility;
+		UpdateReplicatedSection(SectionIndex, nullptr);
+
+		if (SceneProxy)
+		{
+			// The static draw of a baked section is cached by the scene, the transform update makes it gather it again
+			if (SectionBakes[DenseIndex].IsValid())
+			{
+				MarkRenderTransformDirty();
+			}
+
+			// Enqueue command to modify render thread info
+			FDeformMeshSceneProxy* DeformMeshSceneProxy = (FDeformMeshSceneProxy*)SceneProxy;
+			ENQUEUE_RENDER_COMMAND(FDeformMeshSectionVisibilityUpdate)(
+				[DeformMeshSceneProxy, DenseIndex, bNewVisibility](FRHICommandListImmediate& RHICmdList)
+				{
+					DeformMeshSceneProxy->SetSectionVisibility_RenderThread(DenseIndex, bNewVisibility);
+				});
+		}
+	}
+}
+
+bool UDeformMeshComponent::IsMeshSectionVisible(int32 SectionIndex) const
+{
+	const int32 DenseIndex = GetDenseSectionIndex(SectionIndex);
+	return (DenseIndex != INDEX_NONE) ? SectionVisibility[DenseIndex] : false;
+}
+
+int32 UDeformMeshComponent::GetNumSections() const
+{
+	return SectionMeshes.Num();
+}
+
+FDeformMeshSectionHandle UDeformMeshComponent::GetSectionHandle(int32 SectionIndex) const
+{
+	if (GetDenseSectionIndex(SectionIndex) != INDEX_NONE)
+	{
+		return FDeformMeshSectionHandle(SectionIndex, SectionSlots[SectionIndex].Generation);
+	}
+	return FDeformMeshSectionHandle();
+}
+
+int32 UDeformMeshComponent::GetSectionIndex(const FDeformMeshSectionHandle& Handle) const
+{
+	return IsValidSectionHandle(Handle) ? Handle.Index : INDEX_NONE;
+}
+
+bool UDeformMeshComponent::IsValidSectionHandle(const FDeformMeshSectionHandle& Handle) const
+{
+	return GetDenseSectionIndex(Handle.Index) != INDEX_NONE && SectionSlots[Handle.Index].Generation == Handle.Generation;
+}
+
+bool UDeformMeshComponent::GetDeformMeshSection(int32 SectionIndex, FDeformMeshSection& OutSection) const
+{
+	const int32 DenseIndex = GetDenseSectionIndex(SectionIndex);
+	if (DenseIndex == INDEX_NONE)
+	{
+		return false;
+	}
+
+	// Gather the section from the packed arrays
+	OutSection.StaticMesh = SectionMeshes[DenseIndex];
+	OutSection.DeformTransform = SectionDeformTransforms[DenseIndex];
+	OutSection.SectionLocalBox = SectionLocalBoxes[DenseIndex];
+	OutSection.bSectionVisible = SectionVisibility[DenseIndex];
+	return true;
+}
+
+void UDeformMeshComponent::SetDeformMeshSection(int32 SectionIndex, const FDeformMeshSection& Section)
+{
+	// Get the section at this index, or a new one
+	const int32 DenseIndex = AllocateSectionSlot(SectionIndex);
+
+	SectionMeshes[DenseIndex] = Section.StaticMesh;
+	SectionDeformTransforms[DenseIndex] = Section.DeformTransform;
+	SectionLocalBoxes[DenseIndex] = Section.SectionLocalBox;
+	SectionVisibility[DenseIndex] = Section.bSectionVisible;
+	SectionParents[DenseIndex] = INDEX_NONE;
+	bSectionHierarchyLevelsDirty = true;
+	SectionDerivedData[DenseIndex] = FDeformMeshDerivedData::Get(Section.StaticMesh, GetDerivedDataFlags());
+	MarkSectionChanged(DenseIndex);
+	ResetSectionBVH(DenseIndex);
+	const FTransform Transform(Section.DeformTransform.GetTransposed());
+	UpdateReplicatedSection(SectionIndex, &Transform);
+
+	UpdateLocalBounds(); // Update overall bounds
+	MarkRenderStateDirty(); // New section requires recreating scene proxy
+}
+
+void UDeformMeshComponent::SetDeformFields(TArray<FDeformMeshFieldGPU>&& Fields, TArray<FIntPoint>&& SectionRanges)
+{
+	// The subsystem assigns the fields again whenever the component is dirty, most of the time they're the same
+	if (SectionRanges == DeformFieldRanges && Fields.Num() == DeformFields.Num()
+		&& (Fields.Num() == 0 || FMemory::Memcmp(Fields.GetData(), DeformFields.GetData(), Fields.Num() * sizeof(FDeformMeshFieldGPU)) == 0))
+	{
+		return;
+	}
+
+	// The sections whose fields changed are deformed differently, a field moving over a baked section takes it back to the deformed draw
+	for (int32 SectionIdx = 0; SectionIdx < SectionChangeFrames.Num(); SectionIdx++)
+	{
+		const FIntPoint OldRange = DeformFieldRanges.IsValidIndex(SectionIdx) ? DeformFieldRanges[SectionIdx] : FIntPoint::ZeroValue;
+		const FIntPoint NewRange = SectionRanges.IsValidIndex(SectionIdx) ? SectionRanges[SectionIdx] : FIntPoint::ZeroValue;
+		if (OldRange.Y != NewRange.Y
+			|| (NewRange.Y > 0 && FMemory::Memcmp(&DeformFields[OldRange.X], &Fields[NewRange.X], NewRange.Y * sizeof(FDeformMeshFieldGPU)) != 0))
+		{
+			MarkSectionChanged(SectionIdx);
+		}
+	}
+
+	// Set game thread state, so a recreated scene proxy starts with the current fields
+	DeformFields = MoveTemp(Fields);
+	DeformFieldRanges = MoveTemp(SectionRanges);
+	if (bSectionBVHsQueried)
+	{
+		StartSectionBVHRefit();
+	}
+
+	if (SceneProxy)
+	{
+		// Enqueue command to modify render thread info
+		FDeformMeshSceneProxy* DeformMeshSceneProxy = (FDeformMeshSceneProxy*)SceneProxy;
+		ENQUEUE_RENDER_COMMAND(FDeformMeshFieldsUpdate)(
+			[DeformMeshSceneProxy, Fields = DeformFields, SectionRanges = DeformFieldRanges](FRHICommandListImmediate& RHICmdList) mutable
+			{
+				DeformMeshSceneProxy->UpdateDeformFields_RenderThread(MoveTemp(Fields), MoveTemp(SectionRanges));
+			});
+	}
+}
+
+void UDeformMeshComponent::UpdateSectionBVHs(bool bForceRefit)
+{
+	SCOPE_CYCLE_COUNTER(STAT_DeformMesh_RefitBVHs);
+	bSectionBVHsQueried = true;
+
+	// The refit started ahead by FinishTransformsUpdate, then the sections that moved since
+	FinishSectionBVHRefit();
+	if (bForceRefit)
+	{
+		FMemory::Memset(SectionBVHsDirty.GetData(), 1, SectionBVHsDirty.Num());
+	}
+	StartSectionBVHRefit();
+	FinishSectionBVHRefit();
+}
+
+void UDeformMeshComponent::StartSectionBVHRefit()
+{
+	// The sections that move while a refit runs stay dirty for the next one
+	if (PendingBVHRefitTask.IsValid())
+	{
+		return;
+	}
+
+	const int32 NumSections = SectionMeshes.Num();
+	SectionBVHs.SetNum(NumSections);
+
+	TArray<FSectionBVHRefit> Refits;
+	for (int32 SectionIdx = 0; SectionIdx < NumSections; SectionIdx++)
+	{
+		if (!SectionBVHsDirty[SectionIdx])
+		{
+			continue;
+		}
+		SectionBVHsDirty[SectionIdx] = 0;
+
+		const UStaticMesh* StaticMesh = SectionMeshes[SectionIdx];
+		TUniquePtr<FDeformMeshSectionBVH>& BVH = SectionBVHs[SectionIdx];
+		if (StaticMesh == nullptr || StaticMesh->GetRenderData() == nullptr)
+		{
+			BVH.Reset();
+			continue;
+		}
+
+		//We're assuming that there's only one LOD
+		const FStaticMeshLODResources& LODResource = StaticMesh->GetRenderData()->LODResources[0];
+		const FPositionVertexBuffer& PositionBuffer = LODResource.VertexBuffers.PositionVertexBuffer;
+		//Cooked meshes only keep their vertices on the CPU if they allow CPU access
+		if (PositionBuffer.GetVertexData() == nullptr)
+		{
+			BVH.Reset();
+			continue;
+		}
+
+		// The worker gets its own copy of everything, the section can change or go away while it runs
+		const int32 SectionIndex = DenseSectionSlots[SectionIdx];
+		FSectionBVHRefit& Refit = Refits.AddDefaulted_GetRef();
+		Refit.SectionIndex = SectionIndex;
+		Refit.Generation = SectionSlots[SectionIndex].Generation;
+		Refit.DeformTransform = SectionDeformTransforms[SectionIdx];
+		Refit.Positions.SetNumUninitialized(PositionBuffer.GetNumVertices());
+		FMemory::Memcpy(Refit.Positions.GetData(), PositionBuffer.GetVertexData(), Refit.Positions.Num() * sizeof(FVector));
+		const FIntPoint FieldRange = DeformFieldRanges.IsValidIndex(SectionIdx) ? DeformFieldRanges[SectionIdx] : FIntPoint::ZeroValue;
+		Refit.Fields = TArray<FDeformMeshFieldGPU>(DeformFields.GetData() + FieldRange.X, FieldRange.Y);
+		if (!BVH.IsValid() || BVH->GetNumVertices() != Refit.Positions.Num())
+		{
+			LODResource.IndexBuffer.GetCopy(Refit.Indices);
+			BVH.Reset();
+		}
+		// The section has no BVH until the refit is finished, the queries wait for it
+		Refit.BVH = MoveTemp(BVH);
+	}
+
+	if (Refits.Num() == 0)
+	{
+		return;
+	}
+
+	const FMatrix LocalToWorld = GetComponentTransform().ToMatrixWithScale();
+	PendingBVHRefits = MakeShared<TArray<FSectionBVHRefit>, ESPMode::ThreadSafe>(MoveTemp(Refits));
+	PendingBVHRefitTask = Async(EAsyncExecution::ThreadPool, [Refits = PendingBVHRefits, LocalToWorld]()
+	{
+		ParallelFor(Refits->Num(), [&Refits, &LocalToWorld](int32 RefitIdx)
+		{
+			FSectionBVHRefit& Refit = (*Refits)[RefitIdx];
+			const FDeformMeshFieldGPU* Fields = Refit.Fields.Num() > 0 ? Refit.Fields.GetData() : nullptr;
+
+			//Evaluate the deformation of the vertices in place, in batches so large sections are spread over the workers too
+			const int32 NumVertices = Refit.Positions.Num();
+			const int32 BatchSize = 1024;
+			ParallelFor(FMath::DivideAndRoundUp(NumVertices, BatchSize), [&](int32 BatchIdx)
+			{
+				const int32 LastVertex = FMath::Min((BatchIdx + 1) * BatchSize, NumVertices);
+				for (int32 VertexIdx = BatchIdx * BatchSize; VertexIdx < LastVertex; VertexIdx++)
+				{
+					Refit.Positions[VertexIdx] = DeformMeshMath::CalcWorldPosition(Refit.Positions[VertexIdx], LocalToWorld,
+					                                                               Refit.DeformTransform, Fields, Refit.Fields.Num());
+				}
+			});
+
+			if (Refit.BVH.IsValid())
+			{
+				Refit.BVH->Refit(MoveTemp(Refit.Positions));
+			}
+			else
+			{
+				Refit.BVH = MakeUnique<FDeformMeshSectionBVH>();
+				Refit.BVH->Build(Refit.Indices, MoveTemp(Refit.Positions));
+			}
+		});
+	});
+}
+
+void UDeformMeshComponent::FinishSectionBVHRefit()
+{
+	if (!PendingBVHRefitTask.IsValid())
+	{
+		return;
+	}
+	PendingBVHRefitTask.Wait();
+	PendingBVHRefitTask.Reset();
+
+	// A section cleared or created again meanwhile has a new generation, and is dirty if it still exists
+	for (FSectionBVHRefit& Refit : *PendingBVHRefits)
+	{
+		const int32 DenseIndex = GetDenseSectionIndex(Refit.SectionIndex);
+		if (DenseIndex != INDEX_NONE && SectionSlots[Refit.SectionIndex].Generation == Refit.Generation)
+		{
+			SectionBVHs[DenseIndex] = MoveTemp(Refit.BVH);
+		}
+	}
+	PendingBVHRefits.Reset();
+}
+
+bool UDeformMeshComponent::LineTraceComponent(FHitResult& OutHit, const FVector Start, const FVector End,
+                                              const FCollisionQueryParams& Params)
+{
+	SCOPE_CYCLE_COUNTER(STAT_DeformMesh_LineTrace);
+	// Like the body instance trace, nothing is hit when the queries are off or the trace ignores this component
+	const AActor* Owner = GetOwner();
+	if (!IsQueryCollisionEnabled() || Params.GetIgnoredComponents().Contains(GetUniqueID())
+		|| (Owner && Params.GetIgnoredActors().Contains(Owner->GetUniqueID())))
+	{
+		return false;
+	}
+	UpdateSectionBVHs();
+
+	float HitTime = 1.f;
+	FVector HitNormal = FVector::ZeroVector;
+	int32 HitTriangle = INDEX_NONE;
+	int32 HitSection = INDEX_NONE;
+	for (int32 SectionIdx = 0; SectionIdx < SectionBVHs.Num(); SectionIdx++)
+	{
+		if (SectionBVHs[SectionIdx].IsValid() && SectionVisibility[SectionIdx] &&
+			SectionBVHs[SectionIdx]->LineTrace(Start, End, HitTime, HitNormal, HitTriangle))
+		{
+			HitSection = SectionIdx;
+		}
+	}
+
+	if (HitSection == INDEX_NONE)
+	{
+		return false;
+	}
+
+	OutHit = FHitResult(HitTime);
+	OutHit.bBlockingHit = true;
+	OutHit.TraceStart = Start;
+	OutHit.TraceEnd = End;
+	OutHit.Location = OutHit.ImpactPoint = Start + (End - Start) * HitTime;
+	OutHit.Normal = OutHit.ImpactNormal = HitNormal;
+	OutHit.Distance = (OutHit.ImpactPoint - Start).Size();
+	OutHit.Component = this;
+	OutHit.Actor = GetOwner();
+	OutHit.Item = DenseSectionSlots[HitSection];
+	if (Params.bReturnFaceIndex)
+	{
+		OutHit.FaceIndex = HitTriangle;
+	}
+	return true;
+}
+
+bool UDeformMeshComponent::OverlapComponent(const FVector& Pos, const FQuat& Rot, const FCollisionShape& CollisionShape)
+{
+	SCOPE_CYCLE_COUNTER(STAT_DeformMesh_Overlap);
+	if (!IsQueryCollisionEnabled())
+	{
+		return false;
+	}
+	UpdateSectionBVHs();
+
+	//Spheres are tested exactly, the other shapes use their world bounding box
+	const bool bSphere = CollisionShape.IsSphere();
+	const FVector ShapeExtent = CollisionShape.GetExtent();
+	const FBox ShapeBox = FBox(-ShapeExtent, ShapeExtent).TransformBy(FTransform(Rot, Pos));
+
+	for (int32 SectionIdx = 0; SectionIdx < SectionBVHs.Num(); SectionIdx++)
+	{
+		if (!SectionBVHs[SectionIdx].IsValid() || !SectionVisibility[SectionIdx])
+		{
+			continue;
+		}
+
+		const bool bOverlap = bSphere
+			                      ? SectionBVHs[SectionIdx]->OverlapSphere(Pos, CollisionShape.GetSphereRadius())
+			                      : SectionBVHs[SectionIdx]->OverlapBox(ShapeBox);
+		if (bOverlap)
+		{
+			return true;
+		}
+	}
+	return false;
+}
+
+void UDeformMeshComponent::UpdateReplicatedSection(int32 SectionIndex, const FTransform* Transform)
+{
+	if (!GetIsReplicated() || GetOwnerRole() != ROLE_Authority)
+	{
+		return;
+	}
+
+	// On the server, the replicated items are indexed by section index
+	TArray<FDeformMeshRepSection>& Items = ReplicatedSections.Items;
+	while (Items.Num() <= SectionIndex)
+	{
+		FDeformMeshRepSection& NewItem = Items.AddDefaulted_GetRef();
+		NewItem.SectionIndex = Items.Num() - 1;
+		ReplicatedSections.MarkItemDirty(NewItem);
+	}
+
+	// A cleared section is sent without a mesh
+	const int32 DenseIndex = GetDenseSectionIndex(SectionIndex);
+	UStaticMesh* const StaticMesh = DenseIndex != INDEX_NONE ? SectionMeshes[DenseIndex] : nullptr;
+	const bool bSectionVisible = DenseIndex != INDEX_NONE ? SectionVisibility[DenseIndex] : true;
+
+	FDeformMeshRepSection& Item = Items[SectionIndex];
+	const FDeformMeshRepTransform RepTransform = Transform ? FDeformMeshRepTransform(*Transform) : Item.Transform;
+
+	// Only send the section if its quantized state changed
+	if (Item.StaticMesh != StaticMesh || Item.bSectionVisible != bSectionVisible || Item.Transform != RepTransform)
+	{
+		Item.StaticMesh = StaticMesh;
+		Item.bSectionVisible = bSectionVisible;
+		Item.Transform = RepTransform;
+		ReplicatedSections.MarkItemDirty(Item);
+	}
+}
+
+void UDeformMeshComponent::ApplyReplicatedSection(const FDeformMeshRepSection& RepSection)
+{
+	const int32 SectionIndex = RepSection.SectionIndex;
+	if (SectionIndex < 0)
+	{
+		return;
+	}
+
+	const int32 DenseIndex = GetDenseSectionIndex(SectionIndex);
+	const bool bSectionExists = DenseIndex != INDEX_NONE;
+	if (RepSection.StaticMesh == nullptr)
+	{
+		if (bSectionExists)
+		{
+			ClearMeshSection(SectionIndex);
+		}
+		return;
+	}
+
+	const FTransform Transform = RepSection.Transform.ToTransform();
+	if (!bSectionExists || SectionMeshes[DenseIndex] != RepSection.StaticMesh)
+	{
+		CreateMeshSection(SectionIndex, RepSection.StaticMesh, Transform);
+	}
+	else
+	{
+		UpdateMeshSectionTransform(SectionIndex, Transform);
+	}
+
+	if (IsMeshSectionVisible(SectionIndex) != RepSection.bSectionVisible)
+	{
+		SetMeshSectionVisible(SectionIndex, RepSection.bSectionVisible);
+	}
+}
+
+void UDeformMeshComponent::OnRep_ReplicatedSections()
+{
+	// The sections were updated by the items callbacks, upload all the received transforms at once
+	FinishTransformsUpdate();
+}
+
+void UDeformMeshComponent::GetLifetimeReplicatedProps(TArray<FLifetimeProperty>& OutLifetimeProps) const
+{
+	Super::GetLifetimeReplicatedProps(OutLifetimeProps);
+
+	DOREPLIFETIME(UDeformMeshComponent, ReplicatedSections);
+}
+
+FPrimitiveSceneProxy* UDeformMeshComponent::CreateSceneProxy()
+{
+	// Dedicated servers only keep the game thread state of the sections
+	if (!FApp::CanEverRender())
+	{
+		return nullptr;
+	}
+
+	// Loaded sections, or sections created before the settings changed, may miss their derived data
+	RefreshSectionDerivedData();
+
+	// The new scene proxy copies the current bakes
+	ChangedSectionBakes.Reset();
+
+	if (!SceneProxy)
+		return new FDeformMeshSceneProxy(this);
+	else
+		return SceneProxy;
+}
+
+int32 UDeformMeshComponent::GetNumMaterials() const
+{
+	// Materials are indexed by section index
+	return SectionSlots.Num();
+}
+
+static FAutoConsoleCommandWithWorldAndArgs GDeformMeshBenchmarkTracesCommand(
+	TEXT("DeformMesh.BenchmarkTraces"),
+	TEXT("Measures the BVH refit time and the line traces per second of every deform mesh component in the world. Arguments: [NumRefits=10] [NumRays=10000]"),
+	FConsoleCommandWithWorldAndArgsDelegate::CreateStatic([](const TArray<FString>& Args, UWorld* World)
+	{
+		const int32 NumRefits = FMath::Max(Args.Num() > 0 ? FCString::Atoi(*Args[0]) : 10, 1);
+		const int32 NumRays = FMath::Max(Args.Num() > 1 ? FCString::Atoi(*Args[1]) : 10000, 1);
+		FRandomStream RandomStream(0x5eed);
+
+		for (TObjectIterator<UDeformMeshComponent> It; It; ++It)
+		{
+			UDeformMeshComponent* Component = *It;
+			//The traces miss the components whose queries are off
+			if (Component->GetWorld() != World || Component->GetNumSections() == 0 || !Component->IsQueryCollisionEnabled())
+			{
+				continue;
+			}
+
+			//Build first, so we only time the refits
+			Component->UpdateSectionBVHs(true);
+			const double RefitStartTime = FPlatformTime::Seconds();
+			for (int32 RefitIdx = 0; RefitIdx < NumRefits; RefitIdx++)
+			{
+				Component->UpdateSectionBVHs(true);
+			}
+			const double RefitTime = (FPlatformTime::Seconds() - RefitStartTime) / NumRefits;
+
+			//Rays going from around the component through a random point of its bounds
+			const FBox Box = Component->Bounds.GetBox();
+			const FBox StartBox = Box.ExpandBy(Box.GetExtent().GetMax());
+			const FCollisionQueryParams Params;
+			int32 NumHits = 0;
+			const double TraceStartTime = FPlatformTime::Seconds();
+			for (int32 RayIdx = 0; RayIdx < NumRays; RayIdx++)
+			{
+				const FVector Start = RandomStream.RandPointInBox(StartBox);
+				const FVector End = Start + (RandomStream.RandPointInBox(Box) - Start) * 2.f;
+				FHitResult Hit;
+				NumHits += Component->LineTraceComponent(Hit, Start, End, Params) ? 1 : 0;
+			}
+			const double TraceTime = FPlatformTime::Seconds() - TraceStartTime;
+
+			UE_LOG(LogDeformMesh, Display, TEXT("%s: %d sections, refit %.3f ms, %.0f rays/s (%d/%d hits)"),
+			       *Component->GetFullName(), Component->GetNumSections(), RefitTime * 1000.0,
+			       NumRays / FMath::Max(TraceTime, SMALL_NUMBER), NumHits, NumRays);
+		}
+	}));
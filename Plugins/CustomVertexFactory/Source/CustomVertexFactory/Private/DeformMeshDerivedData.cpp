@@ -0,0 +1,378 @@
+﻿// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "DeformMeshDerivedData.h"
+#include "DeformMeshIndexOptimizer.h"
+#include "DeformMeshStats.h"
+#include "Engine/StaticMesh.h"
+#include "Algo/Sort.h"
+#include "Misc/Crc.h"
+#include "Serialization/CustomVersion.h"
+
+DECLARE_CYCLE_STAT(TEXT("Quantize Positions"), STAT_DeformMesh_QuantizePositions, STATGROUP_DeformMesh);
+DECLARE_CYCLE_STAT(TEXT("Optimize Indices"), STAT_DeformMesh_OptimizeIndices, STATGROUP_DeformMesh);
+DECLARE_CYCLE_STAT(TEXT("Build Clusters"), STAT_DeformMesh_BuildClusters, STATGROUP_DeformMesh);
+
+/* Versions of the data of FDeformMeshDerivedData saved by Serialize*/
+struct FDeformMeshDerivedDataCustomVersion
+{
+	enum Type
+	{
+		BeforeCustomVersionWasAdded = 0,
+		// The vertex count, index count and index hash of the mesh the indices were derived from
+		SourceIndices,
+
+		VersionPlusOne,
+		LatestVersion = VersionPlusOne - 1
+	};
+
+	static const FGuid GUID;
+};
+
+const FGuid FDeformMeshDerivedDataCustomVersion::GUID(0x7A2C64E1, 0x3F9B4D08, 0x8E51C2A6, 0x1D7F93B5);
+static FCustomVersionRegistration GRegisterDeformMeshDerivedDataCustomVersion(FDeformMeshDerivedDataCustomVersion::GUID, FDeformMeshDerivedDataCustomVersion::LatestVersion, TEXT("DeformMeshDerivedDataVer"));
+
+/* Most triangles in a cluster, small enough that a localized dent only pulls in a few clusters, big enough to keep the number of draws low*/
+static constexpr int32 MaxClusterTriangles = 256;
+
+/* Derived data of the meshes in use, the sections own it and this only finds it again*/
+static TMap<const UStaticMesh*, TWeakPtr<FDeformMeshDerivedData, ESPMode::ThreadSafe>> GDeformMeshDerivedData;
+
+void FDeformMeshQuantizedPositionBuffer::InitRHI()
+{
+	FRHIResourceCreateInfo CreateInfo;
+	CreateInfo.ResourceArray = &Positions;
+	CreateInfo.DebugName = TEXT("DeformMesh_QuantizedPositions");
+	VertexBufferRHI = RHICreateVertexBuffer(Positions.GetResourceDataSize(), BUF_Static, CreateInfo);
+}
+
+FDeformMeshDerivedData::FDeformMeshDerivedData(const void* InSourceRenderData)
+	: SourceRenderData(InSourceRenderData)
+	, SourceNumVertices(0)
+	, SourceNumIndices(0)
+	, SourceIndicesHash(0)
+	, PositionScale(1.f, 1.f, 1.f, 1.f)
+	, PositionBias(0.f, 0.f, 0.f, 0.f)
+	, bHasQuantizedPositions(false)
+	, BuiltFlags(EDeformMeshDerivedDataFlags::None)
+	, bHasOptimizedIndices(false)
+	, bHasClusters(false)
+{
+}
+
+FDeformMeshDerivedData::~FDeformMeshDerivedData()
+{
+	check(IsInRenderingThread());
+	QuantizedPositions.ReleaseResource();
+}
+
+void FDeformMeshDerivedData::SetSourceIndices(int32 NumVertices, const TArray<uint32>& SourceIndices)
+{
+	SourceNumVertices = NumVertices;
+	SourceNumIndices = SourceIndices.Num();
+	SourceIndicesHash = FCrc::MemCrc32(SourceIndices.GetData(), SourceIndices.Num() * sizeof(uint32));
+}
+
+bool FDeformMeshDerivedData::MatchesSourceIndices(const UStaticMesh* StaticMesh) const
+{
+	//We're assuming that there's only one LOD
+	const FStaticMeshLODResources& LODResource = StaticMesh->GetRenderData()->LODResources[0];
+	if (LODResource.VertexBuffers.PositionVertexBuffer.GetNumVertices() != SourceNumVertices || (uint32)LODResource.IndexBuffer.GetNumIndices() != SourceNumIndices)
+	{
+		return false;
+	}
+
+	//Cooked meshes only keep their indices on the CPU if they allow CPU access, the counts are all there is to compare then
+	TArray<uint32> SourceIndices;
+	LODResource.IndexBuffer.GetCopy(SourceIndices);
+	return SourceIndices.Num() == 0 || FCrc::MemCrc32(SourceIndices.GetData(), SourceIndices.Num() * sizeof(uint32)) == SourceIndicesHash;
+}
+
+void FDeformMeshDerivedData::BuildQuantizedPositions(const UStaticMesh* StaticMesh)
+{
+	SCOPE_CYCLE_COUNTER(STAT_DeformMesh_QuantizePositions);
+
+	//We're assuming that there's only one LOD
+	const FPositionVertexBuffer& PositionBuffer = StaticMesh->GetRenderData()->LODResources[0].VertexBuffers.PositionVertexBuffer;
+	const int32 NumVertices = PositionBuffer.GetNumVertices();
+	//Cooked meshes only keep their vertices on the CPU if they allow CPU access
+	if (NumVertices == 0 || PositionBuffer.GetVertexData() == nullptr)
+	{
+		UE_LOG(LogDeformMesh, Warning, TEXT("Can't quantize the positions of %s, its vertices aren't available on the CPU"), *StaticMesh->GetName());
+		return;
+	}
+
+	//Quantize to the vertex bounds rather than the mesh bounds, these can be extended
+	FBox Box(ForceInit);
+	for (int32 VertexIdx = 0; VertexIdx < NumVertices; VertexIdx++)
+	{
+		Box += PositionBuffer.VertexPosition(VertexIdx);
+	}
+	DeformMeshQuantization::GetDequantization(Box, PositionScale, PositionBias);
+
+	QuantizedPositions.Positions.SetNumUninitialized(NumVertices);
+	FVector MaxObservedError = FVector::ZeroVector;
+	for (int32 VertexIdx = 0; VertexIdx < NumVertices; VertexIdx++)
+	{
+		const FVector& Position = PositionBuffer.VertexPosition(VertexIdx);
+		const FDeformMeshPackedPosition Packed = DeformMeshQuantization::Encode(Position, Box);
+		QuantizedPositions.Positions[VertexIdx] = Packed;
+		MaxObservedError = MaxObservedError.ComponentMax((DeformMeshQuantization::Decode(Packed, PositionScale, PositionBias) - Position).GetAbs());
+	}
+
+	//The decoded positions must stay within half a step of the source on each axis, plus the float rounding of the decode
+	const FVector MaxError = DeformMeshQuantization::GetMaxDecodeError(Box);
+	ensureMsgf(MaxObservedError.X <= MaxError.X && MaxObservedError.Y <= MaxError.Y && MaxObservedError.Z <= MaxError.Z,
+	           TEXT("Quantized positions of %s are off by %s, more than the expected %s"), *StaticMesh->GetName(), *MaxObservedError.ToString(), *MaxError.ToString());
+
+	BeginInitResource(&QuantizedPositions);
+	bHasQuantizedPositions = true;
+}
+
+void FDeformMeshDerivedData::BuildOptimizedIndices(const UStaticMesh* StaticMesh)
+{
+	SCOPE_CYCLE_COUNTER(STAT_DeformMesh_OptimizeIndices);
+
+	//We're assuming that there's only one LOD
+	const FStaticMeshLODResources& LODResource = StaticMesh->GetRenderData()->LODResources[0];
+	const int32 NumVertices = LODResource.VertexBuffers.PositionVertexBuffer.GetNumVertices();
+	TArray<uint32> SourceIndices;
+	LODResource.IndexBuffer.GetCopy(SourceIndices);
+	SetSourceIndices(NumVertices, SourceIndices);
+
+	TArray<uint32> Reordered;
+	if (!DeformMeshIndexOptimizer::OptimizeTriangleOrder(SourceIndices, NumVertices, Reordered))
+	{
+		UE_LOG(LogDeformMesh, Warning, TEXT("Can't optimize the indices of %s, they aren't a valid triangle list"), *StaticMesh->GetName());
+		return;
+	}
+
+	const float SourceACMR = DeformMeshIndexOptimizer::CalcACMR(SourceIndices, NumVertices);
+	const float OptimizedACMR = DeformMeshIndexOptimizer::CalcACMR(Reordered, NumVertices);
+	UE_LOG(LogDeformMesh, Log, TEXT("Index order of %s: ACMR %.3f -> %.3f, ATVR %.3f -> %.3f"), *StaticMesh->GetName(),
+	       SourceACMR, OptimizedACMR,
+	       DeformMeshIndexOptimizer::CalcATVR(SourceIndices, NumVertices), DeformMeshIndexOptimizer::CalcATVR(Reordered, NumVertices));
+
+	//Meshes that were already optimized at import keep their order
+	if (OptimizedACMR < SourceACMR)
+	{
+		OptimizedIndices = MoveTemp(Reordered);
+		bHasOptimizedIndices = true;
+	}
+}
+
+void FDeformMeshDerivedData::BuildClusters(const UStaticMesh* StaticMesh)
+{
+	SCOPE_CYCLE_COUNTER(STAT_DeformMesh_BuildClusters);
+
+	//We're assuming that there's only one LOD
+	const FStaticMeshLODResources& LODResource = StaticMesh->GetRenderData()->LODResources[0];
+	const FPositionVertexBuffer& PositionBuffer = LODResource.VertexBuffers.PositionVertexBuffer;
+	if (PositionBuffer.GetVertexData() == nullptr)
+	{
+		UE_LOG(LogDeformMesh, Warning, TEXT("Can't cluster the triangles of %s, its vertices aren't available on the CPU"), *StaticMesh->GetName());
+		return;
+	}
+
+	TArray<uint32> SourceIndices;
+	if (bHasOptimizedIndices)
+	{
+		SourceIndices = OptimizedIndices;
+	}
+	else
+	{
+		LODResource.IndexBuffer.GetCopy(SourceIndices);
+		SetSourceIndices(PositionBuffer.GetNumVertices(), SourceIndices);
+	}
+
+	//A single cluster would always be drawn deformed
+	const int32 NumTriangles = SourceIndices.Num() / 3;
+	if (NumTriangles <= MaxClusterTriangles)
+	{
+		return;
+	}
+
+	TArray<FVector> Centroids;
+	Centroids.SetNumUninitialized(NumTriangles);
+	for (int32 TriangleIdx = 0; TriangleIdx < NumTriangles; TriangleIdx++)
+	{
+		Centroids[TriangleIdx] = (PositionBuffer.VertexPosition(SourceIndices[TriangleIdx * 3 + 0])
+			+ PositionBuffer.VertexPosition(SourceIndices[TriangleIdx * 3 + 1])
+			+ PositionBuffer.VertexPosition(SourceIndices[TriangleIdx * 3 + 2])) / 3.f;
+	}
+
+	TArray<int32> Triangles;
+	Triangles.SetNumUninitialized(NumTriangles);
+	for (int32 TriangleIdx = 0; TriangleIdx < NumTriangles; TriangleIdx++)
+	{
+		Triangles[TriangleIdx] = TriangleIdx;
+	}
+
+	//Split the triangles at the median centroid along the longest axis until they fit in a cluster
+	//The ranges are popped in depth first order, the second half is pushed first so the first half comes out first
+	TArray<FIntPoint> Ranges;
+	Ranges.Add(FIntPoint(0, NumTriangles));
+	while (Ranges.Num() > 0)
+	{
+		const FIntPoint Range = Ranges.Pop(false);
+		const int32 Count = Range.Y - Range.X;
+		if (Count <= MaxClusterTriangles)
+		{
+			//Keep the incoming order inside the cluster, it's the vertex cache friendly one if it was optimized
+			Algo::Sort(MakeArrayView(Triangles.GetData() + Range.X, Count));
+
+			FDeformMeshCluster& Cluster = Clusters.AddDefaulted_GetRef();
+			Cluster.FirstIndex = ClusteredIndices.Num();
+			Cluster.NumTriangles = Count;
+			Cluster.LocalBox = FBox(ForceInit);
+			for (int32 Idx = Range.X; Idx < Range.Y; Idx++)
+			{
+				for (int32 Corner = 0; Corner < 3; Corner++)
+				{
+					const uint32 VertexIndex = SourceIndices[Triangles[Idx] * 3 + Corner];
+					ClusteredIndices.Add(VertexIndex);
+					Cluster.LocalBox += PositionBuffer.VertexPosition(VertexIndex);
+				}
+			}
+			continue;
+		}
+
+		FBox CentroidBox(ForceInit);
+		for (int32 Idx = Range.X; Idx < Range.Y; Idx++)
+		{
+			CentroidBox += Centroids[Triangles[Idx]];
+		}
+		const FVector Extent = CentroidBox.GetExtent();
+		const int32 Axis = Extent.X >= Extent.Y && Extent.X >= Extent.Z ? 0 : (Extent.Y >= Extent.Z ? 1 : 2);
+		Algo::Sort(MakeArrayView(Triangles.GetData() + Range.X, Count), [&Centroids, Axis](int32 A, int32 B)
+		{
+			return Centroids[A][Axis] < Centroids[B][Axis];
+		});
+
+		const int32 Middle = Range.X + Count / 2;
+		Ranges.Add(FIntPoint(Middle, Range.Y));
+		Ranges.Add(FIntPoint(Range.X, Middle));
+	}
+
+	Clusters.Shrink();
+	bHasClusters = true;
+}
+
+TSharedPtr<FDeformMeshDerivedData, ESPMode::ThreadSafe> FDeformMeshDerivedData::Make(const void* InSourceRenderData)
+{
+	//The render resources are released on the render thread, after the proxies that use them
+	return MakeShareable(new FDeformMeshDerivedData(InSourceRenderData), [](FDeformMeshDerivedData* Data)
+	{
+		ENQUEUE_RENDER_COMMAND(FDeformMeshReleaseDerivedData)([Data](FRHICommandListImmediate& RHICmdList)
+		{
+			delete Data;
+		});
+	});
+}
+
+TSharedPtr<FDeformMeshDerivedData, ESPMode::ThreadSafe> FDeformMeshDerivedData::MakeForLoading()
+{
+	return Make(nullptr);
+}
+
+void FDeformMeshDerivedData::Register(UStaticMesh* StaticMesh, const TSharedPtr<FDeformMeshDerivedData, ESPMode::ThreadSafe>& DerivedData)
+{
+	check(IsInGameThread());
+	if (StaticMesh == nullptr || StaticMesh->GetRenderData() == nullptr || !DerivedData.IsValid())
+	{
+		return;
+	}
+
+	//The sections already using derived data of this mesh keep it, the new sections get the loaded one
+	if (const TWeakPtr<FDeformMeshDerivedData, ESPMode::ThreadSafe>* Existing = GDeformMeshDerivedData.Find(StaticMesh))
+	{
+		const TSharedPtr<FDeformMeshDerivedData, ESPMode::ThreadSafe> ExistingData = Existing->Pin();
+		if (ExistingData.IsValid() && ExistingData->SourceRenderData == StaticMesh->GetRenderData() && ExistingData->HasBuilt(DerivedData->BuiltFlags))
+		{
+			return;
+		}
+	}
+
+	//The mesh may have been reimported or edited since the indices were saved, they could reach past its vertices
+	if ((DerivedData->bHasOptimizedIndices || DerivedData->bHasClusters) && !DerivedData->MatchesSourceIndices(StaticMesh))
+	{
+		UE_LOG(LogDeformMesh, Log, TEXT("Dropping the saved derived data of %s, the mesh changed since it was saved"), *StaticMesh->GetName());
+		return;
+	}
+
+	DerivedData->SourceRenderData = StaticMesh->GetRenderData();
+	GDeformMeshDerivedData.Add(StaticMesh, DerivedData);
+}
+
+void FDeformMeshDerivedData::Serialize(FArchive& Ar)
+{
+	Ar.UsingCustomVersion(FDeformMeshDerivedDataCustomVersion::GUID);
+
+	//The quantized positions are built again when they're needed
+	uint8 SerializedFlags = (uint8)(BuiltFlags & ~EDeformMeshDerivedDataFlags::QuantizedPositions);
+	Ar << SerializedFlags;
+	Ar << bHasOptimizedIndices;
+	OptimizedIndices.BulkSerialize(Ar);
+	Ar << bHasClusters;
+	ClusteredIndices.BulkSerialize(Ar);
+	Ar << Clusters;
+	//Older data doesn't know its source and never matches a mesh
+	if (Ar.CustomVer(FDeformMeshDerivedDataCustomVersion::GUID) >= FDeformMeshDerivedDataCustomVersion::SourceIndices)
+	{
+		Ar << SourceNumVertices;
+		Ar << SourceNumIndices;
+		Ar << SourceIndicesHash;
+	}
+
+	if (Ar.IsLoading())
+	{
+		BuiltFlags = (EDeformMeshDerivedDataFlags)SerializedFlags;
+	}
+}
+
+TSharedPtr<FDeformMeshDerivedData, ESPMode::ThreadSafe> FDeformMeshDerivedData::Get(UStaticMesh* StaticMesh, EDeformMeshDerivedDataFlags Flags)
+{
+	check(IsInGameThread());
+	if (StaticMesh == nullptr || StaticMesh->GetRenderData() == nullptr)
+	{
+		return nullptr;
+	}
+
+	TSharedPtr<FDeformMeshDerivedData, ESPMode::ThreadSafe> DerivedData;
+	if (const TWeakPtr<FDeformMeshDerivedData, ESPMode::ThreadSafe>* Existing = GDeformMeshDerivedData.Find(StaticMesh))
+	{
+		DerivedData = Existing->Pin();
+	}
+
+	if (!DerivedData.IsValid() || DerivedData->SourceRenderData != StaticMesh->GetRenderData())
+	{
+		DerivedData = Make(StaticMesh->GetRenderData());
+		GDeformMeshDerivedData.Add(StaticMesh, DerivedData);
+
+		//Forget the meshes that nobody uses anymore
+		for (auto It = GDeformMeshDerivedData.CreateIterator(); It; ++It)
+		{
+			if (!It.Value().IsValid())
+			{
+				It.RemoveCurrent();
+			}
+		}
+	}
+
+	//Each part is only tried once, even when it doesn't apply to the mesh
+	if (EnumHasAnyFlags(Flags, EDeformMeshDerivedDataFlags::QuantizedPositions) && !DerivedData->HasBuilt(EDeformMeshDerivedDataFlags::QuantizedPositions))
+	{
+		DerivedData->BuildQuantizedPositions(StaticMesh);
+	}
+	if (EnumHasAnyFlags(Flags, EDeformMeshDerivedDataFlags::OptimizedIndices) && !DerivedData->HasBuilt(EDeformMeshDerivedDataFlags::OptimizedIndices))
+	{
+		DerivedData->BuildOptimizedIndices(StaticMesh);
+	}
+	//After the optimized indices, the clusters are cut from them when both are requested
+	if (EnumHasAnyFlags(Flags, EDeformMeshDerivedDataFlags::Clusters) && !DerivedData->HasBuilt(EDeformMeshDerivedDataFlags::Clusters))
+	{
+		DerivedData->BuildClusters(StaticMesh);
+	}
+	DerivedData->BuiltFlags |= Flags;
+	return DerivedData;
+}
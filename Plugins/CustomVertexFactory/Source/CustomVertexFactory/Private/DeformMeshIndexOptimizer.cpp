@@ -0,0 +1,224 @@
+﻿// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "DeformMeshIndexOptimizer.h"
+
+/* Scoring constants from Forsyth's paper*/
+static const int32 ScoringCacheSize = 32;
+static const float CacheDecayPower = 1.5f;
+static const float LastTriScore = 0.75f;
+static const float ValenceBoostScale = 2.f;
+static const float ValenceBoostPower = 0.5f;
+
+/* Score of a vertex given its position in the simulated LRU cache and the number of triangles still using it*/
+static float CalcVertexScore(int32 CachePosition, int32 NumRemainingTriangles)
+{
+	if (NumRemainingTriangles == 0)
+	{
+		return -1.f;
+	}
+
+	float Score = 0.f;
+	if (CachePosition >= 0)
+	{
+		// The vertices of the last triangle get a fixed score, so the next triangle doesn't just reuse its edge
+		if (CachePosition < 3)
+		{
+			Score = LastTriScore;
+		}
+		else
+		{
+			const float Scaler = 1.f / (ScoringCacheSize - 3);
+			Score = FMath::Pow(1.f - (CachePosition - 3) * Scaler, CacheDecayPower);
+		}
+	}
+
+	// Favor the vertices with few triangles left, so they're finished and don't come back later
+	return Score + ValenceBoostScale * FMath::Pow((float)NumRemainingTriangles, -ValenceBoostPower);
+}
+
+bool DeformMeshIndexOptimizer::OptimizeTriangleOrder(const TArray<uint32>& Indices, int32 NumVertices, TArray<uint32>& OutIndices)
+{
+	const int32 NumTriangles = Indices.Num() / 3;
+	if (Indices.Num() % 3 != 0 || NumVertices <= 0)
+	{
+		return false;
+	}
+	for (const uint32 Index : Indices)
+	{
+		if (Index >= (uint32)NumVertices)
+		{
+			return false;
+		}
+	}
+
+	// Triangles of each vertex, packed, the first NumRemaining of each vertex are the ones not emitted yet
+	TArray<int32> VertexTriangleOffsets;
+	TArray<int32> NumRemaining;
+	VertexTriangleOffsets.SetNumZeroed(NumVertices + 1);
+	NumRemaining.SetNumZeroed(NumVertices);
+	for (const uint32 Index : Indices)
+	{
+		NumRemaining[Index]++;
+	}
+	for (int32 VertexIdx = 0; VertexIdx < NumVertices; VertexIdx++)
+	{
+		VertexTriangleOffsets[VertexIdx + 1] = VertexTriangleOffsets[VertexIdx] + NumRemaining[VertexIdx];
+	}
+	TArray<int32> VertexTriangles;
+	VertexTriangles.SetNumUninitialized(Indices.Num());
+	{
+		TArray<int32> Fill;
+		Fill.SetNumZeroed(NumVertices);
+		for (int32 IndexIdx = 0; IndexIdx < Indices.Num(); IndexIdx++)
+		{
+			const uint32 Index = Indices[IndexIdx];
+			VertexTriangles[VertexTriangleOffsets[Index] + Fill[Index]++] = IndexIdx / 3;
+		}
+	}
+
+	TArray<int32> CachePositions;
+	TArray<float> VertexScores;
+	CachePositions.Init(INDEX_NONE, NumVertices);
+	VertexScores.SetNumUninitialized(NumVertices);
+	for (int32 VertexIdx = 0; VertexIdx < NumVertices; VertexIdx++)
+	{
+		VertexScores[VertexIdx] = CalcVertexScore(INDEX_NONE, NumRemaining[VertexIdx]);
+	}
+
+	TArray<float> TriangleScores;
+	TBitArray<> TriangleEmitted(false, NumTriangles);
+	TriangleScores.SetNumUninitialized(NumTriangles);
+	for (int32 TriangleIdx = 0; TriangleIdx < NumTriangles; TriangleIdx++)
+	{
+		TriangleScores[TriangleIdx] = VertexScores[Indices[TriangleIdx * 3]] + VertexScores[Indices[TriangleIdx * 3 + 1]] + VertexScores[Indices[TriangleIdx * 3 + 2]];
+	}
+
+	// Simulated LRU cache, with room for the 3 vertices pushed before the oldest ones are dropped
+	TArray<int32, TInlineAllocator<ScoringCacheSize + 3>> Cache;
+	TArray<int32, TInlineAllocator<ScoringCacheSize + 3>> NewCache;
+
+	OutIndices.Reset(Indices.Num());
+	int32 BestTriangle = INDEX_NONE;
+	int32 NextUnemitted = 0;
+	for (int32 EmittedCount = 0; EmittedCount < NumTriangles; EmittedCount++)
+	{
+		// Nothing in the cache leads anywhere, restart from the first triangle left
+		if (BestTriangle == INDEX_NONE)
+		{
+			while (TriangleEmitted[NextUnemitted])
+			{
+				NextUnemitted++;
+			}
+			BestTriangle = NextUnemitted;
+		}
+
+		const int32 Triangle = BestTriangle;
+		TriangleEmitted[Triangle] = true;
+		NewCache.Reset();
+		for (int32 Corner = 0; Corner < 3; Corner++)
+		{
+			const uint32 Vertex = Indices[Triangle * 3 + Corner];
+			OutIndices.Add(Vertex);
+			NewCache.AddUnique(Vertex);
+
+			// Move the emitted triangle out of the remaining triangles of the vertex
+			const int32 Offset = VertexTriangleOffsets[Vertex];
+			const int32 Remaining = --NumRemaining[Vertex];
+			for (int32 TriIdx = Offset; TriIdx <= Offset + Remaining; TriIdx++)
+			{
+				if (VertexTriangles[TriIdx] == Triangle)
+				{
+					Swap(VertexTriangles[TriIdx], VertexTriangles[Offset + Remaining]);
+					break;
+				}
+			}
+		}
+
+		// The triangle's vertices go to the front, the others keep their order
+		for (const int32 Vertex : Cache)
+		{
+			if (!NewCache.Contains(Vertex))
+			{
+				NewCache.Add(Vertex);
+			}
+		}
+		for (int32 CacheIdx = 0; CacheIdx < NewCache.Num(); CacheIdx++)
+		{
+			CachePositions[NewCache[CacheIdx]] = CacheIdx < ScoringCacheSize ? CacheIdx : INDEX_NONE;
+		}
+
+		// Rescore the vertices that moved, and the triangles they're part of, the best of them is the next triangle
+		BestTriangle = INDEX_NONE;
+		float BestScore = -1.f;
+		for (const int32 Vertex : NewCache)
+		{
+			const float NewScore = CalcVertexScore(CachePositions[Vertex], NumRemaining[Vertex]);
+			const float ScoreDelta = NewScore - VertexScores[Vertex];
+			VertexScores[Vertex] = NewScore;
+
+			const int32 Offset = VertexTriangleOffsets[Vertex];
+			for (int32 TriIdx = Offset; TriIdx < Offset + NumRemaining[Vertex]; TriIdx++)
+			{
+				const int32 AdjacentTriangle = VertexTriangles[TriIdx];
+				TriangleScores[AdjacentTriangle] += ScoreDelta;
+			}
+		}
+		for (const int32 Vertex : NewCache)
+		{
+			const int32 Offset = VertexTriangleOffsets[Vertex];
+			for (int32 TriIdx = Offset; TriIdx < Offset + NumRemaining[Vertex]; TriIdx++)
+			{
+				const int32 AdjacentTriangle = VertexTriangles[TriIdx];
+				if (TriangleScores[AdjacentTriangle] > BestScore)
+				{
+					BestScore = TriangleScores[AdjacentTriangle];
+					BestTriangle = AdjacentTriangle;
+				}
+			}
+		}
+
+		NewCache.SetNum(FMath::Min(NewCache.Num(), ScoringCacheSize), false);
+		Swap(Cache, NewCache);
+	}
+
+	return true;
+}
+
+/* Number of vertex shader invocations for these indices with a FIFO post-transform cache*/
+static int32 CountCacheMisses(const TArray<uint32>& Indices, int32 NumVertices, int32 CacheSize)
+{
+	// Each vertex remembers when it entered the cache, it's still in it if less than CacheSize vertices entered since
+	TArray<int32> EnteredAt;
+	EnteredAt.Init(-CacheSize, NumVertices);
+	int32 NumMisses = 0;
+	for (const uint32 Index : Indices)
+	{
+		if (Index < (uint32)NumVertices && NumMisses - EnteredAt[Index] >= CacheSize)
+		{
+			EnteredAt[Index] = NumMisses++;
+		}
+	}
+	return NumMisses;
+}
+
+float DeformMeshIndexOptimizer::CalcACMR(const TArray<uint32>& Indices, int32 NumVertices, int32 CacheSize)
+{
+	const int32 NumTriangles = Indices.Num() / 3;
+	return NumTriangles > 0 ? (float)CountCacheMisses(Indices, NumVertices, CacheSize) / NumTriangles : 0.f;
+}
+
+float DeformMeshIndexOptimizer::CalcATVR(const TArray<uint32>& Indices, int32 NumVertices, int32 CacheSize)
+{
+	TBitArray<> Referenced(false, NumVertices);
+	int32 NumReferenced = 0;
+	for (const uint32 Index : Indices)
+	{
+		if (Index < (uint32)NumVertices && !Referenced[Index])
+		{
+			Referenced[Index] = true;
+			NumReferenced++;
+		}
+	}
+	return NumReferenced > 0 ? (float)CountCacheMisses(Indices, NumVertices, CacheSize) / NumReferenced : 0.f;
+}
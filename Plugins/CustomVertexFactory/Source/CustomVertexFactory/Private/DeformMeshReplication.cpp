@@ -0,0 +1,75 @@
+﻿// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "DeformMeshReplication.h"
+#include "DeformMeshComponent.h"
+
+FDeformMeshRepTransform::FDeformMeshRepTransform(const FTransform& Transform)
+{
+	//Quantize the same way NetSerialize does
+	const FVector InTranslation = Transform.GetTranslation();
+	Translation = FVector(FMath::RoundToFloat(InTranslation.X * 10.f) / 10.f,
+	                      FMath::RoundToFloat(InTranslation.Y * 10.f) / 10.f,
+	                      FMath::RoundToFloat(InTranslation.Z * 10.f) / 10.f);
+
+	const FRotator InRotation = Transform.Rotator();
+	Rotation = FRotator(FRotator::DecompressAxisFromShort(FRotator::CompressAxisToShort(InRotation.Pitch)),
+	                    FRotator::DecompressAxisFromShort(FRotator::CompressAxisToShort(InRotation.Yaw)),
+	                    FRotator::DecompressAxisFromShort(FRotator::CompressAxisToShort(InRotation.Roll)));
+
+	const FVector InScale = Transform.GetScale3D();
+	Scale = FVector(FMath::RoundToFloat(InScale.X * 100.f) / 100.f,
+	                FMath::RoundToFloat(InScale.Y * 100.f) / 100.f,
+	                FMath::RoundToFloat(InScale.Z * 100.f) / 100.f);
+}
+
+FTransform FDeformMeshRepTransform::ToTransform() const
+{
+	return FTransform(Rotation, Translation, Scale);
+}
+
+bool FDeformMeshRepTransform::NetSerialize(FArchive& Ar, UPackageMap* Map, bool& bOutSuccess)
+{
+	bOutSuccess = SerializePackedVector<10, 24>(Translation, Ar);
+
+	Rotation.SerializeCompressedShort(Ar);
+
+	uint8 bUnitScale = Scale.Equals(FVector::OneVector, 0.f) ? 1 : 0;
+	Ar.SerializeBits(&bUnitScale, 1);
+	if (bUnitScale)
+	{
+		Scale = FVector::OneVector;
+	}
+	else
+	{
+		bOutSuccess &= SerializePackedVector<100, 30>(Scale, Ar);
+	}
+
+	return true;
+}
+
+void FDeformMeshRepSection::PreReplicatedRemove(const FDeformMeshRepSectionArray& InArraySerializer)
+{
+	if (InArraySerializer.Owner)
+	{
+		FDeformMeshRepSection ClearedSection = *this;
+		ClearedSection.StaticMesh = nullptr;
+		InArraySerializer.Owner->ApplyReplicatedSection(ClearedSection);
+	}
+}
+
+void FDeformMeshRepSection::PostReplicatedAdd(const FDeformMeshRepSectionArray& InArraySerializer)
+{
+	if (InArraySerializer.Owner)
+	{
+		InArraySerializer.Owner->ApplyReplicatedSection(*this);
+	}
+}
+
+void FDeformMeshRepSection::PostReplicatedChange(const FDeformMeshRepSectionArray& InArraySerializer)
+{
+	if (InArraySerializer.Owner)
+	{
+		InArraySerializer.Owner->ApplyReplicatedSection(*this);
+	}
+}
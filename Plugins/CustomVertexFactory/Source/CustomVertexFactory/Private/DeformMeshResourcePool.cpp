@@ -0,0 +1,263 @@
+﻿// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "DeformMeshResourcePool.h"
+#include "DeformMeshStats.h"
+#include "HAL/IConsoleManager.h"
+#include "Misc/CoreDelegates.h"
+#include "RenderingThread.h"
+#include "UObject/UObjectGlobals.h"
+
+DECLARE_DWORD_ACCUMULATOR_STAT(TEXT("Pooled Section Hits"), STAT_DeformMesh_PooledSectionHits, STATGROUP_DeformMesh);
+DECLARE_DWORD_ACCUMULATOR_STAT(TEXT("Pooled Section Misses"), STAT_DeformMesh_PooledSectionMisses, STATGROUP_DeformMesh);
+DECLARE_DWORD_ACCUMULATOR_STAT(TEXT("Pooled Buffer Hits"), STAT_DeformMesh_PooledBufferHits, STATGROUP_DeformMesh);
+DECLARE_DWORD_ACCUMULATOR_STAT(TEXT("Pooled Buffer Misses"), STAT_DeformMesh_PooledBufferMisses, STATGROUP_DeformMesh);
+DECLARE_FLOAT_ACCUMULATOR_STAT(TEXT("Section Pool Hit Rate %"), STAT_DeformMesh_SectionPoolHitRate, STATGROUP_DeformMesh);
+DECLARE_FLOAT_ACCUMULATOR_STAT(TEXT("Buffer Pool Hit Rate %"), STAT_DeformMesh_BufferPoolHitRate, STATGROUP_DeformMesh);
+DECLARE_MEMORY_STAT(TEXT("Pooled Resource Memory"), STAT_DeformMesh_PooledMemory, STATGROUP_DeformMesh);
+
+static TAutoConsoleVariable<int32> CVarDeformMeshResourcePoolSize(
+	TEXT("DeformMesh.ResourcePoolSize"),
+	64,
+	TEXT("Number of destroyed scene proxies whose section proxies, and whose structured buffers, are kept for the next deform mesh scene proxies. 0 disables the pool."),
+	ECVF_RenderThreadSafe);
+
+static FAutoConsoleCommand GDeformMeshDumpResourcePoolCommand(
+	TEXT("DeformMesh.DumpResourcePool"),
+	TEXT("Logs the resources held by the deform mesh resource pool and its hit rates"),
+	FConsoleCommandDelegate::CreateStatic([]()
+	{
+		ENQUEUE_RENDER_COMMAND(DumpDeformMeshResourcePool)([](FRHICommandListImmediate& RHICmdList)
+		{
+			FDeformMeshResourcePool::Get().Dump_RenderThread();
+		});
+	}));
+
+/* Helper function that flushes the pool from the game thread*/
+static void EnqueueResourcePoolFlush()
+{
+	ENQUEUE_RENDER_COMMAND(FlushDeformMeshResourcePool)([](FRHICommandListImmediate& RHICmdList)
+	{
+		FDeformMeshResourcePool::Get().Flush_RenderThread();
+	});
+}
+
+/* Helper function that returns a hit rate in percents*/
+static float CalcHitRate(uint32 Hits, uint32 Misses)
+{
+	return Hits + Misses > 0 ? 100.f * Hits / (Hits + Misses) : 0.f;
+}
+
+FDeformMeshResourcePool::FDeformMeshResourcePool(): PooledBytes(0), SectionHits(0), SectionMisses(0), BufferHits(0), BufferMisses(0)
+{
+}
+
+FDeformMeshResourcePool& FDeformMeshResourcePool::Get()
+{
+	static FDeformMeshResourcePool Pool;
+	return Pool;
+}
+
+void FDeformMeshResourcePool::Startup()
+{
+	FDeformMeshResourcePool& Pool = Get();
+	//A collected static mesh releases the vertex buffers the pooled vertex factories are bound to, and its memory may be reused by the next mesh
+	//The components destroyed by the collection give their resources back before the flush, the render commands run in order
+	Pool.PostGarbageCollectHandle = FCoreUObjectDelegates::GetPostGarbageCollect().AddStatic(&EnqueueResourcePoolFlush);
+	//The pooled RHI resources must be released while the RHI is still there
+	Pool.PreExitHandle = FCoreDelegates::OnEnginePreExit.AddStatic(&EnqueueResourcePoolFlush);
+}
+
+void FDeformMeshResourcePool::Shutdown()
+{
+	FDeformMeshResourcePool& Pool = Get();
+	FCoreUObjectDelegates::GetPostGarbageCollect().Remove(Pool.PostGarbageCollectHandle);
+	FCoreDelegates::OnEnginePreExit.Remove(Pool.PreExitHandle);
+}
+
+uint32 FDeformMeshResourcePool::GetTransformsCapacity(int32 NumSections)
+{
+	return FMath::RoundUpToPowerOfTwo(FMath::Max(NumSections, 1));
+}
+
+uint32 FDeformMeshResourcePool::HashSources(const TArray<FDeformMeshSectionSource>& Sources)
+{
+	uint32 Hash = Sources.Num();
+	for (const FDeformMeshSectionSource& Source : Sources)
+	{
+		Hash = HashCombine(Hash, GetTypeHash(Source));
+	}
+	return Hash;
+}
+
+uint32 FDeformMeshResourcePool::GetBuffersBytes(const FDeformMeshPooledBuffers& Buffers)
+{
+	return (Buffers.TransformsSB ? Buffers.TransformsSB->GetSize() : 0) + (Buffers.FieldsSB ? Buffers.FieldsSB->GetSize() : 0);
+}
+
+void FDeformMeshResourcePool::ReleaseSections(TArrayView<FDeformMeshSectionProxy> Sections)
+{
+	check(IsInRenderingThread());
+	for (FDeformMeshSectionProxy& Section : Sections)
+	{
+		Section.IndexBuffer.ReleaseResource();
+		Section.VertexFactory.ReleaseResource();
+		Section.~FDeformMeshSectionProxy();
+	}
+	FMemory::Free(Sections.GetData());
+}
+
+void FDeformMeshResourcePool::UpdateHitRateStats() const
+{
+	SET_FLOAT_STAT(STAT_DeformMesh_SectionPoolHitRate, CalcHitRate(SectionHits, SectionMisses));
+	SET_FLOAT_STAT(STAT_DeformMesh_BufferPoolHitRate, CalcHitRate(BufferHits, BufferMisses));
+}
+
+bool FDeformMeshResourcePool::AcquireSections_RenderThread(ERHIFeatureLevel::Type FeatureLevel, const TArray<FDeformMeshSectionSource>& Sources,
+                                                           TArrayView<FDeformMeshSectionProxy>& OutSections, TBitArray<>& OutResidency)
+{
+	check(IsInRenderingThread());
+	const uint32 SourcesHash = HashSources(Sources);
+
+	//The most recently pooled sections first, they're the most likely to be resident
+	for (int32 EntryIdx = PooledSections.Num() - 1; EntryIdx >= 0; EntryIdx--)
+	{
+		FPooledSections& Entry = PooledSections[EntryIdx];
+		if (Entry.SourcesHash != SourcesHash || Entry.FeatureLevel != FeatureLevel || Entry.Sources != Sources)
+		{
+			continue;
+		}
+
+		OutSections = Entry.Sections;
+		OutResidency = MoveTemp(Entry.Residency);
+		PooledBytes -= Entry.ResidentBytes;
+		DEC_MEMORY_STAT_BY(STAT_DeformMesh_PooledMemory, Entry.ResidentBytes);
+		PooledSections.RemoveAt(EntryIdx);
+
+		SectionHits++;
+		INC_DWORD_STAT(STAT_DeformMesh_PooledSectionHits);
+		UpdateHitRateStats();
+		return true;
+	}
+
+	SectionMisses++;
+	INC_DWORD_STAT(STAT_DeformMesh_PooledSectionMisses);
+	UpdateHitRateStats();
+	return false;
+}
+
+void FDeformMeshResourcePool::ReleaseSections_RenderThread(TArray<FDeformMeshSectionSource>&& Sources, TArrayView<FDeformMeshSectionProxy> Sections,
+                                                           TBitArray<>&& Residency, uint32 ResidentBytes, TArray<TSharedPtr<FDeformMeshDerivedData, ESPMode::ThreadSafe>>&& DerivedData)
+{
+	check(IsInRenderingThread());
+	const int32 MaxEntries = CVarDeformMeshResourcePoolSize.GetValueOnRenderThread();
+	if (MaxEntries <= 0 || Sections.Num() == 0)
+	{
+		ReleaseSections(Sections);
+		return;
+	}
+
+	while (PooledSections.Num() >= MaxEntries)
+	{
+		const FPooledSections& Oldest = PooledSections[0];
+		ReleaseSections(Oldest.Sections);
+		PooledBytes -= Oldest.ResidentBytes;
+		DEC_MEMORY_STAT_BY(STAT_DeformMesh_PooledMemory, Oldest.ResidentBytes);
+		PooledSections.RemoveAt(0);
+	}
+
+	//The scene proxy the vertex factories point to is being destroyed, the next one sets itself
+	for (FDeformMeshSectionProxy& Section : Sections)
+	{
+		Section.VertexFactory.SetSceneProxy(nullptr);
+	}
+
+	FPooledSections& Entry = PooledSections.AddDefaulted_GetRef();
+	Entry.SourcesHash = HashSources(Sources);
+	Entry.FeatureLevel = Sections[0].VertexFactory.GetFeatureLevel();
+	Entry.Sources = MoveTemp(Sources);
+	Entry.Sections = Sections;
+	Entry.Residency = MoveTemp(Residency);
+	Entry.ResidentBytes = ResidentBytes;
+	Entry.DerivedData = MoveTemp(DerivedData);
+	PooledBytes += ResidentBytes;
+	INC_MEMORY_STAT_BY(STAT_DeformMesh_PooledMemory, ResidentBytes);
+}
+
+bool FDeformMeshResourcePool::AcquireBuffers_RenderThread(int32 NumSections, FDeformMeshPooledBuffers& OutBuffers)
+{
+	check(IsInRenderingThread());
+	const uint32 NumTransforms = GetTransformsCapacity(NumSections);
+	for (int32 EntryIdx = PooledBuffers.Num() - 1; EntryIdx >= 0; EntryIdx--)
+	{
+		if (PooledBuffers[EntryIdx].NumTransforms != NumTransforms)
+		{
+			continue;
+		}
+
+		OutBuffers = MoveTemp(PooledBuffers[EntryIdx]);
+		PooledBuffers.RemoveAt(EntryIdx);
+		PooledBytes -= GetBuffersBytes(OutBuffers);
+		DEC_MEMORY_STAT_BY(STAT_DeformMesh_PooledMemory, GetBuffersBytes(OutBuffers));
+
+		BufferHits++;
+		INC_DWORD_STAT(STAT_DeformMesh_PooledBufferHits);
+		UpdateHitRateStats();
+		return true;
+	}
+
+	BufferMisses++;
+	INC_DWORD_STAT(STAT_DeformMesh_PooledBufferMisses);
+	UpdateHitRateStats();
+	return false;
+}
+
+void FDeformMeshResourcePool::ReleaseBuffers_RenderThread(FDeformMeshPooledBuffers&& Buffers)
+{
+	check(IsInRenderingThread());
+	const int32 MaxEntries = CVarDeformMeshResourcePoolSize.GetValueOnRenderThread();
+	if (MaxEntries <= 0 || !Buffers.TransformsSB)
+	{
+		return;
+	}
+
+	while (PooledBuffers.Num() >= MaxEntries)
+	{
+		PooledBytes -= GetBuffersBytes(PooledBuffers[0]);
+		DEC_MEMORY_STAT_BY(STAT_DeformMesh_PooledMemory, GetBuffersBytes(PooledBuffers[0]));
+		PooledBuffers.RemoveAt(0);
+	}
+
+	PooledBytes += GetBuffersBytes(Buffers);
+	INC_MEMORY_STAT_BY(STAT_DeformMesh_PooledMemory, GetBuffersBytes(Buffers));
+	PooledBuffers.Add(MoveTemp(Buffers));
+}
+
+void FDeformMeshResourcePool::Flush_RenderThread()
+{
+	check(IsInRenderingThread());
+	for (const FPooledSections& Entry : PooledSections)
+	{
+		ReleaseSections(Entry.Sections);
+	}
+	PooledSections.Empty();
+	PooledBuffers.Empty();
+
+	DEC_MEMORY_STAT_BY(STAT_DeformMesh_PooledMemory, PooledBytes);
+	PooledBytes = 0;
+}
+
+void FDeformMeshResourcePool::Dump_RenderThread() const
+{
+	check(IsInRenderingThread());
+	int32 NumPooledSections = 0;
+	for (const FPooledSections& Entry : PooledSections)
+	{
+		NumPooledSections += Entry.Sections.Num();
+	}
+
+	UE_LOG(LogDeformMesh, Log, TEXT("Deform mesh resource pool: %d section sets (%d sections), %d buffer sets, %u bytes"),
+	       PooledSections.Num(), NumPooledSections, PooledBuffers.Num(), PooledBytes);
+	UE_LOG(LogDeformMesh, Log, TEXT("  Sections: %u hits, %u misses, %.1f%% hit rate"), SectionHits, SectionMisses, CalcHitRate(SectionHits, SectionMisses));
+	UE_LOG(LogDeformMesh, Log, TEXT("  Buffers: %u hits, %u misses, %.1f%% hit rate"), BufferHits, BufferMisses, CalcHitRate(BufferHits, BufferMisses));
+}
@@ -2,6 +2,29 @@
 
 
 #include "DeformMeshSceneProxy.h"
+#include "DeformMeshMath.h"
+#include "DeformMeshResourcePool.h"
+#include "DeformMeshStats.h"
+#include "Async/Async.h"
+
+DECLARE_CYCLE_STAT(TEXT("Update Section Residency"), STAT_DeformMesh_UpdateResidency, STATGROUP_DeformMesh);
+DECLARE_MEMORY_STAT(TEXT("Resident Section Memory"), STAT_DeformMesh_ResidentMemory, STATGROUP_DeformMesh);
+DECLARE_MEMORY_STAT(TEXT("Evicted Section Memory"), STAT_DeformMesh_EvictedMemory, STATGROUP_DeformMesh);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Deformed Cluster Triangles"), STAT_DeformMesh_DeformedClusterTriangles, STATGROUP_DeformMesh);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Static Cluster Triangles"), STAT_DeformMesh_StaticClusterTriangles, STATGROUP_DeformMesh);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Mesh Batches Allocated"), STAT_DeformMesh_MeshBatches, STATGROUP_DeformMesh);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Mesh Batches Submitted"), STAT_DeformMesh_SubmittedMeshBatches, STATGROUP_DeformMesh);
+
+/* Static runs shorter than this are drawn deformed with their neighbours, an extra draw costs more than deforming a few far vertices that end up in place anyway*/
+static constexpr uint32 MinStaticRunTriangles = 512;
+
+/* A contiguous range of clusters drawn with the same vertex factory*/
+struct FDeformMeshClusterRun
+{
+	uint32 FirstIndex;
+	uint32 NumTriangles;
+	bool bDeformed;
+};
 
 /* Helper function that initializes a render resource if it's not initialized, or updates it otherwise*/
 static inline void InitOrUpdateResource(FRenderResource* Resource)
@@ -20,104 +43,286 @@ static inline void InitOrUpdateResource(FRenderResource* Resource)
  * Helper function that initializes the vertex buffers of the vertex factory's Data member from the static mesh vertex buffers
  * We're using this so we can initialize only the data that we're interested in.
 */
-static void InitVertexFactoryData(FDeformMeshVertexFactory* VertexFactory, FStaticMeshVertexBuffers* VertexBuffers)
+static void InitVertexFactoryData(FDeformMeshVertexFactory* VertexFactory, FStaticMeshVertexBuffers* VertexBuffers,
+                                  FDeformMeshQuantizedPositionBuffer* QuantizedPositions)
 {
-	ENQUEUE_RENDER_COMMAND(StaticMeshVertexBuffersLegacyInit)(
-		[VertexFactory, VertexBuffers](FRHICommandListImmediate& RHICmdList)
-		{
-			//Initialize or update the RHI vertex buffers
-			InitOrUpdateResource(&VertexBuffers->PositionVertexBuffer);
-			InitOrUpdateResource(&VertexBuffers->StaticMeshVertexBuffer);
-
-			//Use the RHI vertex buffers to create the needed Vertex stream components in an FDataType instance, and then set it as the data of the vertex factory
-			FLocalVertexFactory::FDataType Data;
-			VertexBuffers->PositionVertexBuffer.BindPositionVertexBuffer(VertexFactory, Data);
-			VertexBuffers->StaticMeshVertexBuffer.BindPackedTexCoordVertexBuffer(VertexFactory, Data);
-			VertexFactory->SetData(Data);
-
-			//Initalize the vertex factory using the data that we just set, this will call the InitRHI() method that we implemented in out vertex factory
-			InitOrUpdateResource(VertexFactory);
-		});
+	check(IsInRenderingThread());
+	//The static mesh initializes its own vertex buffers, they're only initialized here if it didn't yet, recreating them would allocate new RHI buffers for each proxy
+	if (!VertexBuffers->PositionVertexBuffer.IsInitialized())
+	{
+		VertexBuffers->PositionVertexBuffer.InitResource();
+	}
+	if (!VertexBuffers->StaticMeshVertexBuffer.IsInitialized())
+	{
+		VertexBuffers->StaticMeshVertexBuffer.InitResource();
+	}
+
+	//Use the RHI vertex buffers to create the needed Vertex stream components in an FDataType instance, and then set it as the data of the vertex factory
+	FLocalVertexFactory::FDataType Data;
+	VertexBuffers->PositionVertexBuffer.BindPositionVertexBuffer(VertexFactory, Data);
+	VertexBuffers->StaticMeshVertexBuffer.BindPackedTexCoordVertexBuffer(VertexFactory, Data);
+	//Fetch the quantized positions instead of the full precision ones, the shader dequantizes them
+	if (QuantizedPositions)
+	{
+		Data.PositionComponent = FVertexStreamComponent(QuantizedPositions, 0, sizeof(FDeformMeshPackedPosition), VET_UShort4N);
+	}
+	//The vertex factory is initialized with the index buffer of its section, by the residency
+	VertexFactory->SetData(Data);
 }
 
 FDeformMeshSceneProxy::FDeformMeshSceneProxy(UDeformMeshComponent* Component): FPrimitiveSceneProxy(Component),
                                                                                MaterialRelevance(
 	                                                                               Component->GetMaterialRelevance(
-		                                                                               GetScene().GetFeatureLevel()))
+		                                                                               GetScene().GetFeatureLevel())),
+                                                                               bInterpolateTransforms(Component->bInterpolateTransforms),
+                                                                               InterpolationDelay(1.f / Component->TransformSampleRate),
+                                                                               PrevSampleTime(0.f),
+                                                                               NextSampleTime(0.f),
+                                                                               LastInterpolationAlpha(-1.f),
+                                                                               LastInterpolationFrame(~0u),
+                                                                               bReleaseHiddenSections(Component->bReleaseHiddenSections),
+                                                                               EvictionDelay(Component->SectionEvictionDelay),
+                                                                               ResidentMemoryBudget(Component->SectionMemoryBudget),
+                                                                               ResidentBytes(0),
+                                                                               ResidencyTime(Component->GetWorld() ? Component->GetWorld()->GetTimeSeconds() : 0.f),
+                                                                               LastDrawTime(ResidencyTime)
 {
-	// Copy each section
-	const uint16 NumSections = Component->DeformMeshSections.Num();
+	// Copy each section, the component keeps its sections packed so there are no holes to skip
+	const int32 NumSections = Component->SectionMeshes.Num();
+
+	//Initialize the array of transforms and the visibility straight from the packed arrays of the component
+	DeformTransforms = Component->SectionDeformTransforms;
+	SectionVisibility = Component->SectionVisibility;
+	SectionResidency.Init(false, NumSections);
+	//A new section gets a full delay before it can be evicted
+	SectionLastRenderTime.Init(ResidencyTime, NumSections);
+	SectionResourceBytes.AddZeroed(NumSections);
+	SectionSources.AddZeroed(NumSections);
+	SectionMaterials.AddZeroed(NumSections);
+	SectionDerivedData = Component->SectionDerivedData;
+	SectionBakes = Component->SectionBakes;
+	SectionBaked.Init(false, NumSections);
+	for (int32 SectionIdx = 0; SectionIdx < NumSections; SectionIdx++)
+	{
+		SectionBaked[SectionIdx] = SectionBakes.IsValidIndex(SectionIdx) && SectionBakes[SectionIdx].IsValid();
+	}
+	bHasBakedSections = SectionBaked.Find(true) != INDEX_NONE;
+	bHasDynamicSections = NumSections == 0 || SectionBaked.Find(false) != INDEX_NONE;
 
-	//Initialize the array of trnasforms and the array of mesh sections proxies
-	DeformTransforms.AddZeroed(NumSections);
-	Sections.AddZeroed(NumSections);
+	//The fields are uploaded with the structured buffers
+	DeformFields = Component->DeformFields;
+	DeformFieldRanges = Component->DeformFieldRanges;
 
-	for (uint16 SectionIdx = 0; SectionIdx < NumSections; SectionIdx++)
+	//Gather what each section proxy is built from, they're built by CreateRenderThreadResources
+	for (int32 SectionIdx = 0; SectionIdx < NumSections; SectionIdx++)
 	{
-		const FDeformMeshSection& SrcSection = Component->DeformMeshSections[SectionIdx];
+		FDeformMeshSectionSource& Source = SectionSources[SectionIdx];
+
+		//Get the needed data from the static mesh of the mesh section
+		//We're assuming that there's only one LOD
+		FStaticMeshRenderData* RenderData = Component->SectionMeshes[SectionIdx]->GetRenderData();
+		FStaticMeshLODResources& LODResource = RenderData->LODResources[0];
+		Source.VertexBuffers = &LODResource.VertexBuffers;
+		Source.SourceIndices = &LODResource.IndexBuffer;
+
+		FDeformMeshDerivedData* DerivedData = SectionDerivedData[SectionIdx].Get();
+		if (Component->bQuantizePositions && DerivedData && DerivedData->HasQuantizedPositions())
 		{
-			//Create a new mesh section proxy
-			FDeformMeshSectionProxy* NewSection = new FDeformMeshSectionProxy(GetScene().GetFeatureLevel());
+			Source.QuantizedPositions = DerivedData->GetQuantizedPositions();
+			Source.PositionScale = DerivedData->GetPositionScale();
+			Source.PositionBias = DerivedData->GetPositionBias();
+		}
 
-			//Get the needed data from the static mesh of the mesh section
-			//We're assuming that there's only one LOD
-			FStaticMeshLODResources& LODResource = SrcSection.StaticMesh->GetRenderData()->LODResources[0];
+		//The clusters are cut from the optimized order when there's one, so they come first
+		if (Component->bSplitDeformClusters && DerivedData && DerivedData->HasClusters())
+		{
+			Source.DerivedIndices = &DerivedData->GetClusteredIndices();
+			Source.Clusters = &DerivedData->GetClusters();
+			Source.StaticVertexFactory = &RenderData->LODVertexFactories[0].VertexFactory;
+		}
+		else if (Component->bOptimizeIndexOrder && DerivedData && DerivedData->HasOptimizedIndices())
+		{
+			Source.DerivedIndices = &DerivedData->GetOptimizedIndices();
+		}
+		SectionResourceBytes[SectionIdx] = LODResource.IndexBuffer.GetNumIndices() * (LODResource.IndexBuffer.Is32Bit() ? sizeof(uint32) : sizeof(uint16));
 
-			FDeformMeshVertexFactory* VertexFactory = &NewSection->VertexFactory;
-			//Initialize the vertex factory with the vertex data from the static mesh using the helper function defined above
-			InitVertexFactoryData(VertexFactory, &(LODResource.VertexBuffers));
+		if (bInterpolateTransforms)
+		{
+			//Start from a still sample
+			const FTransform Sample(DeformTransforms[SectionIdx].GetTransposed());
+			PrevTransformSamples.Add(Sample);
+			NextTransformSamples.Add(Sample);
+		}
 
-			//Initialize the additional data using setters (Transform Index and pointer to this scene proxy that holds reference to the structured buffer and its SRV
-			VertexFactory->SetTransformIndex(SectionIdx);
-			VertexFactory->SetSceneProxy(this);
+		//Get the material of this section, materials are indexed by section index
+		SectionMaterials[SectionIdx] = Component->GetMaterial(Component->DenseSectionSlots[SectionIdx]);
 
-			//Copy the indices from the static mesh index buffer and use it to initialize the mesh section proxy's index buffer
+		if (SectionMaterials[SectionIdx] == NULL)
+		{
+			SectionMaterials[SectionIdx] = UMaterial::GetDefaultMaterial(MD_Surface);
+		}
+	}
+}
+
+FDeformMeshSceneProxy::~FDeformMeshSceneProxy()
+{
+	//The workers may still be copying indices for us
+	for (FSectionRestore& Restore : PendingRestores)
+	{
+		Restore.Indices.Wait();
+	}
+
+	uint32 EvictedBytes = 0;
+	for (int32 SectionIdx = 0; SectionIdx < Sections.Num(); SectionIdx++)
+	{
+		EvictedBytes += SectionResidency[SectionIdx] ? 0 : SectionResourceBytes[SectionIdx];
+	}
+	DEC_MEMORY_STAT_BY(STAT_DeformMesh_ResidentMemory, ResidentBytes);
+	DEC_MEMORY_STAT_BY(STAT_DeformMesh_EvictedMemory, EvictedBytes);
+
+	//The section proxies, with their index buffers and vertex factories, and the structured buffers go to the pool for the next proxies
+	//The proxy may be destroyed before it was added to the scene, then it has none
+	if (Sections.Num() > 0)
+	{
+		FDeformMeshResourcePool& Pool = FDeformMeshResourcePool::Get();
+		Pool.ReleaseSections_RenderThread(MoveTemp(SectionSources), Sections, MoveTemp(SectionResidency), ResidentBytes, MoveTemp(SectionDerivedData));
+
+		FDeformMeshPooledBuffers Buffers;
+		Buffers.NumTransforms = FDeformMeshResourcePool::GetTransformsCapacity(Sections.Num());
+		Buffers.TransformsSB = MoveTemp(DeformTransformsSB);
+		Buffers.TransformsSRV = MoveTemp(DeformTransformsSRV);
+		Buffers.FieldsSB = MoveTemp(DeformFieldsSB);
+		Buffers.FieldsSRV = MoveTemp(DeformFieldsSRV);
+		Pool.ReleaseBuffers_RenderThread(MoveTemp(Buffers));
+	}
+}
+
+void FDeformMeshSceneProxy::CreateRenderThreadResources()
+{
+	check(IsInRenderingThread());
+	//Nothing to draw or to bind without sections
+	if (SectionSources.Num() > 0)
+	{
+		CreateSections_RenderThread();
+		CreateBuffers_RenderThread();
+	}
+}
+
+void FDeformMeshSceneProxy::CreateSections_RenderThread()
+{
+	check(IsInRenderingThread());
+	const int32 NumSections = SectionSources.Num();
+	const ERHIFeatureLevel::Type FeatureLevel = GetScene().GetFeatureLevel();
+
+	//The section proxies of a destroyed proxy with the same sources come with their index buffers and vertex factories initialized
+	TBitArray<> PooledResidency;
+	if (!FDeformMeshResourcePool::Get().AcquireSections_RenderThread(FeatureLevel, SectionSources, Sections, PooledResidency))
+	{
+		//All the mesh section proxies live in one block of memory
+		Sections = MakeArrayView((FDeformMeshSectionProxy*)FMemory::Malloc(NumSections * sizeof(FDeformMeshSectionProxy), alignof(FDeformMeshSectionProxy)), NumSections);
+		PooledResidency.Init(false, NumSections);
+
+		for (int32 SectionIdx = 0; SectionIdx < NumSections; SectionIdx++)
+		{
+			const FDeformMeshSectionSource& Source = SectionSources[SectionIdx];
+
+			//Construct the mesh section proxy in place
+			FDeformMeshSectionProxy* NewSection = new(&Sections[SectionIdx]) FDeformMeshSectionProxy(FeatureLevel);
+
+			//Initialize the vertex factory with the vertex data from the static mesh using the helper function defined above
+			if (Source.QuantizedPositions)
 			{
-				TArray<uint32> tmp_indices;
-				LODResource.IndexBuffer.GetCopy(tmp_indices);
-				NewSection->IndexBuffer.AppendIndices(tmp_indices.GetData(), tmp_indices.Num());
-				//Initialize the render resource
-				BeginInitResource(&NewSection->IndexBuffer);
+				NewSection->VertexFactory.SetPositionDequantization(Source.PositionScale, Source.PositionBias);
 			}
-
-			//Fill the array of transforms with the transform matrix from each section
-			DeformTransforms[SectionIdx] = SrcSection.DeformTransform;
+			InitVertexFactoryData(&NewSection->VertexFactory, Source.VertexBuffers, Source.QuantizedPositions);
 
 			//Set the max vertex index for this mesh section
-			NewSection->MaxVertexIndex = LODResource.VertexBuffers.PositionVertexBuffer.GetNumVertices() - 1;
+			NewSection->MaxVertexIndex = Source.VertexBuffers->PositionVertexBuffer.GetNumVertices() - 1;
+			NewSection->Clusters = Source.Clusters;
+			NewSection->StaticVertexFactory = Source.StaticVertexFactory;
+		}
+	}
+
+	for (int32 SectionIdx = 0; SectionIdx < NumSections; SectionIdx++)
+	{
+		FDeformMeshSectionProxy& Section = Sections[SectionIdx];
 
-			//Get the material of this section
-			NewSection->Material = Component->GetMaterial(SectionIdx);
+		//Initialize the additional data using setters (Transform Index and pointer to this scene proxy that holds reference to the structured buffer and its SRV
+		Section.VertexFactory.SetTransformIndex(SectionIdx);
+		Section.VertexFactory.SetSceneProxy(this);
+		Section.Material = SectionMaterials[SectionIdx];
 
-			if (NewSection->Material == NULL)
+		//With the residency policy, hidden sections start evicted, their indices are only copied when they're shown
+		if (bReleaseHiddenSections && !SectionVisibility[SectionIdx])
+		{
+			if (PooledResidency[SectionIdx])
 			{
-				NewSection->Material = UMaterial::GetDefaultMaterial(MD_Surface);
+				Section.IndexBuffer.ReleaseResource();
+				Section.VertexFactory.ReleaseResource();
 			}
+			INC_MEMORY_STAT_BY(STAT_DeformMesh_EvictedMemory, SectionResourceBytes[SectionIdx]);
+			continue;
+		}
 
-			// Copy visibility info
-			NewSection->bSectionVisible = SrcSection.bSectionVisible;
-
-			// Save ref to new section
-			Sections[SectionIdx] = NewSection;
+		//Copy the derived indices, or the ones of the static mesh index buffer, and use them to initialize the mesh section proxy's index buffer
+		if (!PooledResidency[SectionIdx])
+		{
+			const FDeformMeshSectionSource& Source = SectionSources[SectionIdx];
+			if (Source.DerivedIndices != nullptr)
+			{
+				Section.IndexBuffer.SetIndices(*Source.DerivedIndices, EIndexBufferStride::AutoDetect);
+			}
+			else
+			{
+				TArray<uint32> tmp_indices;
+				Source.SourceIndices->GetCopy(tmp_indices);
+				Section.IndexBuffer.AppendIndices(tmp_indices.GetData(), tmp_indices.Num());
+			}
+			//Initialize the render resources
+			Section.IndexBuffer.InitResource();
+			InitOrUpdateResource(&Section.VertexFactory);
 		}
+
+		SectionResidency[SectionIdx] = true;
+		ResidentBytes += SectionResourceBytes[SectionIdx];
+		INC_MEMORY_STAT_BY(STAT_DeformMesh_ResidentMemory, SectionResourceBytes[SectionIdx]);
 	}
+}
 
-	//Create the structured buffer only if we have at least one section
-	if (NumSections > 0)
+void FDeformMeshSceneProxy::CreateBuffers_RenderThread()
+{
+	check(IsInRenderingThread());
+	const int32 NumSections = SectionSources.Num();
+
+	//The buffers of a destroyed proxy with about as many sections only need this proxy's transforms
+	FDeformMeshPooledBuffers Buffers;
+	if (FDeformMeshResourcePool::Get().AcquireBuffers_RenderThread(NumSections, Buffers))
+	{
+		DeformTransformsSB = MoveTemp(Buffers.TransformsSB);
+		DeformTransformsSRV = MoveTemp(Buffers.TransformsSRV);
+		DeformFieldsSB = MoveTemp(Buffers.FieldsSB);
+		DeformFieldsSRV = MoveTemp(Buffers.FieldsSRV);
+		bDeformTransformsDirty = true;
+		UpdateDeformTransformsSB_RenderThread();
+	}
+	else
 	{
 		///////////////////////////////////////////////////////////////
 		//// CREATING THE STRUCTURED BUFFER FOR THE DEFORM TRANSFORMS OF ALL THE SECTIONS
 		//We'll use one structured buffer for all the mesh sections of the component
+		//It holds a power of two number of transforms so the pool can give it to a proxy with a close number of sections
+		const uint32 NumTransforms = FDeformMeshResourcePool::GetTransformsCapacity(NumSections);
 
 		//We first create a resource array to use it in the create info for initializing the structured buffer on creation
 		TResourceArray<FMatrix>* ResourceArray = new TResourceArray<FMatrix>(true);
 		FRHIResourceCreateInfo CreateInfo;
 		ResourceArray->Append(DeformTransforms);
+		ResourceArray->AddZeroed(NumTransforms - NumSections);
 		CreateInfo.ResourceArray = ResourceArray;
 		//Set the debug name so we can find the resource when debugging in RenderDoc
 		CreateInfo.DebugName = TEXT("DeformMesh_TransformsSB");
 
-		DeformTransformsSB = RHICreateStructuredBuffer(sizeof(FMatrix), NumSections * sizeof(FMatrix),
+		DeformTransformsSB = RHICreateStructuredBuffer(sizeof(FMatrix), NumTransforms * sizeof(FMatrix),
 		                                               BUF_ShaderResource, CreateInfo);
 		bDeformTransformsDirty = false;
 		///////////////////////////////////////////////////////////////
@@ -126,24 +331,9 @@ FDeformMeshSceneProxy::FDeformMeshSceneProxy(UDeformMeshComponent* Component): F
 
 		///////////////////////////////////////////////////////////////
 	}
-}
-
-FDeformMeshSceneProxy::~FDeformMeshSceneProxy()
-{
-	//For each section , release the render resources
-	for (FDeformMeshSectionProxy* Section : Sections)
-	{
-		if (Section != nullptr)
-		{
-			Section->IndexBuffer.ReleaseResource();
-			Section->VertexFactory.ReleaseResource();
-			delete Section;
-		}
-	}
 
-	//Release the structured buffer and the SRV
-	DeformTransformsSB.SafeRelease();
-	DeformTransformsSRV.SafeRelease();
+	//Upload the fields that the component already has, the fields structured buffer is created or grown if needed
+	SetDeformFields(CopyTemp(DeformFields), DeformFieldRanges);
 }
 
 void FDeformMeshSceneProxy::UpdateDeformTransformsSB_RenderThread()
@@ -160,26 +350,311 @@ void FDeformMeshSceneProxy::UpdateDeformTransformsSB_RenderThread()
 	}
 }
 
-void FDeformMeshSceneProxy::UpdateDeformTransform_RenderThread(int32 SectionIndex, FMatrix Transform)
+void FDeformMeshSceneProxy::UpdateDeformTransforms_RenderThread(const TArray<FDeformMeshTransformUpdate>& Updates, float SampleTime)
 {
 	check(IsInRenderingThread());
-	if (SectionIndex < Sections.Num() &&
-		Sections[SectionIndex] != nullptr)
+	if (!bInterpolateTransforms)
 	{
-		DeformTransforms[SectionIndex] = Transform;
+		for (const FDeformMeshTransformUpdate& Update : Updates)
+		{
+			UpdateDeformTransform_RenderThread(Update.Index, Update.DeformTransform);
+		}
+		UpdateDeformTransformsSB_RenderThread();
+		return;
+	}
+
+	//The sample we were interpolating to becomes the start of the interpolation
+	//The interpolation lags one sample interval behind, so the sections are still short of that sample when the next one comes
+	//Snap them to it, a section missing from the new sample would otherwise stay between its two last samples
+	for (const int32 DenseIndex : InterpolatedSections)
+	{
+		PrevTransformSamples[DenseIndex] = NextTransformSamples[DenseIndex];
+		UpdateDeformTransform_RenderThread(DenseIndex, NextTransformSamples[DenseIndex].ToMatrixWithScale().GetTransposed());
+	}
+	InterpolatedSections.Reset();
+
+	for (const FDeformMeshTransformUpdate& Update : Updates)
+	{
+		if (NextTransformSamples.IsValidIndex(Update.Index))
+		{
+			NextTransformSamples[Update.Index] = FTransform(Update.DeformTransform.GetTransposed());
+			InterpolatedSections.AddUnique(Update.Index);
+		}
+	}
+
+	PrevSampleTime = NextSampleTime;
+	NextSampleTime = SampleTime;
+	LastInterpolationAlpha = -1.f;
+}
+
+void FDeformMeshSceneProxy::InterpolateTransforms_RenderThread(float WorldTime)
+{
+	check(IsInRenderingThread());
+	const float Duration = NextSampleTime - PrevSampleTime;
+	const float Alpha = Duration > SMALL_NUMBER
+		                    ? FMath::Clamp((WorldTime - InterpolationDelay - PrevSampleTime) / Duration, 0.f, 1.f)
+		                    : 1.f;
+
+	//Nothing moved since the last frame, either we're paused or we already reached the last sample
+	if (Alpha == LastInterpolationAlpha)
+	{
+		return;
+	}
+	LastInterpolationAlpha = Alpha;
+
+	for (const int32 DenseIndex : InterpolatedSections)
+	{
+		const FTransform& Prev = PrevTransformSamples[DenseIndex];
+		const FTransform& Next = NextTransformSamples[DenseIndex];
+		const FTransform Interpolated(FQuat::Slerp(Prev.GetRotation(), Next.GetRotation(), Alpha),
+		                              FMath::Lerp(Prev.GetTranslation(), Next.GetTranslation(), Alpha),
+		                              FMath::Lerp(Prev.GetScale3D(), Next.GetScale3D(), Alpha));
+		UpdateDeformTransform_RenderThread(DenseIndex, Interpolated.ToMatrixWithScale().GetTransposed());
+	}
+	UpdateDeformTransformsSB_RenderThread();
+}
+
+void FDeformMeshSceneProxy::UpdateDeformTransform_RenderThread(int32 DenseIndex, FMatrix Transform)
+{
+	check(IsInRenderingThread());
+	//The transforms updated before the structured buffer is created are uploaded with it
+	if (DeformTransforms.IsValidIndex(DenseIndex))
+	{
+		DeformTransforms[DenseIndex] = Transform;
 		//Mark as dirty
 		bDeformTransformsDirty = true;
 	}
 }
 
-void FDeformMeshSceneProxy::SetSectionVisibility_RenderThread(int32 SectionIndex, bool bNewVisibility)
+void FDeformMeshSceneProxy::SetDeformFields(TArray<FDeformMeshFieldGPU>&& Fields, const TArray<FIntPoint>& SectionRanges)
+{
+	DeformFields = MoveTemp(Fields);
+	DeformFieldRanges = SectionRanges;
+
+	//Each section's vertex factory knows where its fields are in the buffer
+	for (int32 SectionIdx = 0; SectionIdx < Sections.Num(); SectionIdx++)
+	{
+		const FIntPoint Range = SectionRanges.IsValidIndex(SectionIdx) ? SectionRanges[SectionIdx] : FIntPoint::ZeroValue;
+		Sections[SectionIdx].VertexFactory.SetFieldRange(Range.X, Range.Y);
+	}
+
+	//The buffer always has at least one entry so there's always something to bind, and it grows by powers of two
+	const uint32 NumFields = FMath::RoundUpToPowerOfTwo(FMath::Max(DeformFields.Num(), 1));
+	const uint32 SizeInBytes = NumFields * sizeof(FDeformMeshFieldGPU);
+
+	if (!DeformFieldsSB || DeformFieldsSB->GetSize() < SizeInBytes)
+	{
+		TResourceArray<FDeformMeshFieldGPU>* ResourceArray = new TResourceArray<FDeformMeshFieldGPU>(true);
+		ResourceArray->Append(DeformFields);
+		ResourceArray->AddZeroed(NumFields - DeformFields.Num());
+		FRHIResourceCreateInfo CreateInfo;
+		CreateInfo.ResourceArray = ResourceArray;
+		CreateInfo.DebugName = TEXT("DeformMesh_FieldsSB");
+
+		DeformFieldsSB = RHICreateStructuredBuffer(sizeof(FDeformMeshFieldGPU), SizeInBytes, BUF_ShaderResource, CreateInfo);
+		DeformFieldsSRV = RHICreateShaderResourceView(DeformFieldsSB);
+	}
+	else if (DeformFields.Num() > 0)
+	{
+		const uint32 UsedBytes = DeformFields.Num() * sizeof(FDeformMeshFieldGPU);
+		void* StructuredBufferData = RHILockStructuredBuffer(DeformFieldsSB, 0, UsedBytes, RLM_WriteOnly);
+		FMemory::Memcpy(StructuredBufferData, DeformFields.GetData(), UsedBytes);
+		RHIUnlockStructuredBuffer(DeformFieldsSB);
+	}
+}
+
+void FDeformMeshSceneProxy::UpdateDeformFields_RenderThread(TArray<FDeformMeshFieldGPU>&& Fields, TArray<FIntPoint>&& SectionRanges)
+{
+	check(IsInRenderingThread());
+	//Nothing to bind the fields to without sections, and before the structured buffers are created the fields are only kept for them
+	if (DeformTransformsSB)
+	{
+		SetDeformFields(MoveTemp(Fields), SectionRanges);
+	}
+	else
+	{
+		DeformFields = MoveTemp(Fields);
+		DeformFieldRanges = MoveTemp(SectionRanges);
+	}
+}
+
+void FDeformMeshSceneProxy::SetSectionVisibility_RenderThread(int32 DenseIndex, bool bNewVisibility)
 {
 	check(IsInRenderingThread());
 
-	if (SectionIndex < Sections.Num() &&
-		Sections[SectionIndex] != nullptr)
+	if (SectionVisibility.IsValidIndex(DenseIndex))
 	{
-		Sections[SectionIndex]->bSectionVisible = bNewVisibility;
+		SectionVisibility[DenseIndex] = bNewVisibility;
+
+		//Don't wait for the first draw to bring the section back, before the sections are created their residency follows their visibility
+		if (bNewVisibility && !SectionResidency[DenseIndex] && Sections.IsValidIndex(DenseIndex))
+		{
+			RequestSectionRestore_RenderThread(DenseIndex);
+		}
+	}
+}
+
+void FDeformMeshSceneProxy::UpdateSectionBakes_RenderThread(const TArray<TPair<int32, TSharedPtr<FDeformMeshBakedSection, ESPMode::ThreadSafe>>>& Bakes)
+{
+	check(IsInRenderingThread());
+
+	for (const TPair<int32, TSharedPtr<FDeformMeshBakedSection, ESPMode::ThreadSafe>>& Bake : Bakes)
+	{
+		const int32 DenseIndex = Bake.Key;
+		if (!SectionBakes.IsValidIndex(DenseIndex))
+		{
+			continue;
+		}
+		SectionBakes[DenseIndex] = Bake.Value;
+		SectionBaked[DenseIndex] = Bake.Value.IsValid();
+
+		//The deform resources of a baked section may have been evicted, bring them back before its next dynamic draw
+		if (!Bake.Value.IsValid() && SectionVisibility[DenseIndex] && !SectionResidency[DenseIndex] && Sections.IsValidIndex(DenseIndex))
+		{
+			RequestSectionRestore_RenderThread(DenseIndex);
+		}
+	}
+
+	bHasBakedSections = SectionBaked.Find(true) != INDEX_NONE;
+	bHasDynamicSections = SectionBaked.Num() == 0 || SectionBaked.Find(false) != INDEX_NONE;
+}
+
+void FDeformMeshSceneProxy::EvictSection_RenderThread(int32 DenseIndex)
+{
+	check(IsInRenderingThread());
+	FDeformMeshSectionProxy& Section = Sections[DenseIndex];
+	Section.IndexBuffer.ReleaseResource();
+	Section.VertexFactory.ReleaseResource();
+
+	SectionResidency[DenseIndex] = false;
+	ResidentBytes -= SectionResourceBytes[DenseIndex];
+	DEC_MEMORY_STAT_BY(STAT_DeformMesh_ResidentMemory, SectionResourceBytes[DenseIndex]);
+	INC_MEMORY_STAT_BY(STAT_DeformMesh_EvictedMemory, SectionResourceBytes[DenseIndex]);
+}
+
+void FDeformMeshSceneProxy::RequestSectionRestore_RenderThread(int32 DenseIndex)
+{
+	check(IsInRenderingThread());
+	if (PendingRestores.ContainsByPredicate([DenseIndex](const FSectionRestore& Restore) { return Restore.DenseIndex == DenseIndex; }))
+	{
+		return;
+	}
+
+	//The static mesh and the derived data outlive this proxy, and their CPU indices don't change while they're used
+	const FRawStaticIndexBuffer* SourceIndices = SectionSources[DenseIndex].SourceIndices;
+	const TArray<uint32>* DerivedIndices = SectionSources[DenseIndex].DerivedIndices;
+	PendingRestores.Add({DenseIndex, Async(EAsyncExecution::ThreadPool, [SourceIndices, DerivedIndices]()
+	{
+		TArray<uint32> Indices;
+		if (DerivedIndices != nullptr)
+		{
+			Indices = *DerivedIndices;
+		}
+		else
+		{
+			SourceIndices->GetCopy(Indices);
+		}
+		return Indices;
+	})});
+}
+
+void FDeformMeshSceneProxy::FinishSectionRestores_RenderThread()
+{
+	check(IsInRenderingThread());
+	for (int32 RestoreIdx = PendingRestores.Num() - 1; RestoreIdx >= 0; RestoreIdx--)
+	{
+		FSectionRestore& Restore = PendingRestores[RestoreIdx];
+		if (!Restore.Indices.IsReady())
+		{
+			continue;
+		}
+
+		const int32 DenseIndex = Restore.DenseIndex;
+		FDeformMeshSectionProxy& Section = Sections[DenseIndex];
+		Section.IndexBuffer.SetIndices(Restore.Indices.Get(), EIndexBufferStride::AutoDetect);
+		Section.IndexBuffer.InitResource();
+		InitOrUpdateResource(&Section.VertexFactory);
+		PendingRestores.RemoveAtSwap(RestoreIdx, 1, false);
+
+		//Give the section a full delay before it can be evicted again
+		SectionResidency[DenseIndex] = true;
+		SectionLastRenderTime[DenseIndex] = ResidencyTime;
+		ResidentBytes += SectionResourceBytes[DenseIndex];
+		INC_MEMORY_STAT_BY(STAT_DeformMesh_ResidentMemory, SectionResourceBytes[DenseIndex]);
+		DEC_MEMORY_STAT_BY(STAT_DeformMesh_EvictedMemory, SectionResourceBytes[DenseIndex]);
+	}
+}
+
+bool FDeformMeshSceneProxy::IsDeformedBox(int32 DenseIndex, const FBox& WorldBox) const
+{
+	//The shader fades the deform transform out at FalloffRadius from its origin, and each field at its radius
+	const FMatrix& DeformTransform = DeformTransforms[DenseIndex];
+	const FVector Origin(DeformTransform.M[0][3], DeformTransform.M[1][3], DeformTransform.M[2][3]);
+	if (FMath::SphereAABBIntersection(FSphere(Origin, DeformMeshMath::FalloffRadius), WorldBox))
+	{
+		return true;
+	}
+
+	const FIntPoint Range = DeformFieldRanges.IsValidIndex(DenseIndex) ? DeformFieldRanges[DenseIndex] : FIntPoint::ZeroValue;
+	for (int32 FieldIdx = Range.X; FieldIdx < Range.X + Range.Y; FieldIdx++)
+	{
+		const FVector4& PositionAndRadius = DeformFields[FieldIdx].PositionAndRadius;
+		if (FMath::SphereAABBIntersection(FSphere(FVector(PositionAndRadius), PositionAndRadius.W), WorldBox))
+		{
+			return true;
+		}
+	}
+	return false;
+}
+
+void FDeformMeshSceneProxy::UpdateResidency_RenderThread(float WorldTime)
+{
+	check(IsInRenderingThread());
+	SCOPE_CYCLE_COUNTER(STAT_DeformMesh_UpdateResidency);
+
+	ResidencyTime = FMath::Max(ResidencyTime, WorldTime);
+	FinishSectionRestores_RenderThread();
+	if (!bReleaseHiddenSections)
+	{
+		return;
+	}
+
+	//Hidden sections aren't drawn either, so they age like the off-screen ones
+	TArray<int32> BudgetCandidates;
+	for (int32 SectionIdx = 0; SectionIdx < Sections.Num(); SectionIdx++)
+	{
+		if (!SectionResidency[SectionIdx])
+		{
+			continue;
+		}
+
+		const float LastRenderTime = SectionLastRenderTime[SectionIdx];
+		if (ResidencyTime - LastRenderTime >= EvictionDelay)
+		{
+			EvictSection_RenderThread(SectionIdx);
+		}
+		else if (LastRenderTime < LastDrawTime)
+		{
+			BudgetCandidates.Add(SectionIdx);
+		}
+	}
+
+	//Over budget, evict what wasn't drawn in the last frame, the hidden sections and then the oldest ones first
+	if (ResidentMemoryBudget > 0 && ResidentBytes > ResidentMemoryBudget)
+	{
+		BudgetCandidates.Sort([this](int32 A, int32 B)
+		{
+			if (SectionVisibility[A] != SectionVisibility[B])
+			{
+				return !SectionVisibility[A];
+			}
+			return SectionLastRenderTime[A] < SectionLastRenderTime[B];
+		});
+
+		for (int32 CandidateIdx = 0; CandidateIdx < BudgetCandidates.Num() && ResidentBytes > ResidentMemoryBudget; CandidateIdx++)
+		{
+			EvictSection_RenderThread(BudgetCandidates[CandidateIdx]);
+		}
 	}
 }
 
@@ -187,6 +662,23 @@ void FDeformMeshSceneProxy::GetDynamicMeshElements(const TArray<const FSceneView
                                                    const FSceneViewFamily& ViewFamily, uint32 VisibilityMap,
                                                    FMeshElementCollector& Collector) const
 {
+	FDeformMeshSceneProxy* MutableThis = const_cast<FDeformMeshSceneProxy*>(this);
+
+	//Interpolate the transforms once per frame, before any view uses them
+	if (bInterpolateTransforms && LastInterpolationFrame != ViewFamily.FrameNumber)
+	{
+		MutableThis->LastInterpolationFrame = ViewFamily.FrameNumber;
+		MutableThis->InterpolateTransforms_RenderThread(ViewFamily.CurrentWorldTime);
+	}
+
+	//Bring back the sections whose indices are ready, and stamp the ones drawn this frame
+	if (bReleaseHiddenSections)
+	{
+		MutableThis->ResidencyTime = FMath::Max(ResidencyTime, ViewFamily.CurrentWorldTime);
+		MutableThis->LastDrawTime = ResidencyTime;
+		MutableThis->FinishSectionRestores_RenderThread();
+	}
+
 	// Set up wireframe material (if needed)
 	const bool bWireframe = AllowDebugViewmodes() && ViewFamily.EngineShowFlags.Wireframe;
 
@@ -201,74 +693,193 @@ void FDeformMeshSceneProxy::GetDynamicMeshElements(const TArray<const FSceneView
 		Collector.RegisterOneFrameMaterialProxy(WireframeMaterialInstance);
 	}
 
-	// Iterate over sections
-	for (const FDeformMeshSectionProxy* Section : Sections)
+	//The LocalVertexFactory uses a uniform buffer to pass primitive data like the local to world transform for this frame and for the previous one
+	//Nothing in it depends on the view or the section, so all the batches share one per frame
+	FDynamicPrimitiveUniformBuffer* DynamicPrimitiveUniformBuffer = nullptr;
+	if (bHasDynamicSections && Sections.Num() > 0)
+	{
+		//Most of this data can be fetched using the helper function below
+		bool bHasPrecomputedVolumetricLightmap;
+		FMatrix PreviousLocalToWorld;
+		int32 SingleCaptureIndex;
+		bool bOutputVelocity;
+		GetScene().GetPrimitiveUniformShaderParameters_RenderThread(
+			GetPrimitiveSceneInfo(), bHasPrecomputedVolumetricLightmap, PreviousLocalToWorld,
+			SingleCaptureIndex, bOutputVelocity);
+		//Allocate a temporary primitive uniform buffer and fill it with the data
+		DynamicPrimitiveUniformBuffer = &Collector.AllocateOneFrameResource<FDynamicPrimitiveUniformBuffer>();
+		DynamicPrimitiveUniformBuffer->Set(GetLocalToWorld(), PreviousLocalToWorld, GetBounds(),
+		                                   GetLocalBounds(), true, bHasPrecomputedVolumetricLightmap,
+		                                   DrawsVelocity(), bOutputVelocity);
+	}
+
+	// Iterate over the visible sections
+	for (TConstSetBitIterator<> VisibleIt(SectionVisibility); VisibleIt; ++VisibleIt)
 	{
-		if (Section != nullptr && Section->bSectionVisible)
+		const int32 SectionIdx = VisibleIt.GetIndex();
+		const FDeformMeshSectionProxy* Section = &Sections[SectionIdx];
+
+		//The baked sections are drawn by DrawStaticElements, their deform resources age and get evicted like the hidden ones
+		if (SectionBaked[SectionIdx])
+		{
+			continue;
+		}
+
+		//An evicted section is drawn again once its restore is done
+		if (!SectionResidency[SectionIdx])
+		{
+			MutableThis->RequestSectionRestore_RenderThread(SectionIdx);
+			continue;
+		}
+		MutableThis->SectionLastRenderTime[SectionIdx] = ResidencyTime;
+
+		//Get the section's materil, or the wireframe material if we're rendering in wireframe mode
+		FMaterialRenderProxy* MaterialProxy = bWireframe
+			                                      ? WireframeMaterialInstance
+			                                      : Section->Material->GetRenderProxy();
+
+		//Split the clustered sections in runs of deformed and static clusters, once for all the views
+		TArray<FDeformMeshClusterRun, TInlineAllocator<8>> Runs;
+		if (Section->Clusters)
+		{
+			const FMatrix& LocalToWorld = GetLocalToWorld();
+			for (const FDeformMeshCluster& Cluster : *Section->Clusters)
+			{
+				const bool bDeformed = IsDeformedBox(SectionIdx, Cluster.LocalBox.TransformBy(LocalToWorld));
+				if (Runs.Num() > 0 && Runs.Last().bDeformed == bDeformed)
+				{
+					Runs.Last().NumTriangles += Cluster.NumTriangles;
+				}
+				else
+				{
+					Runs.Add({Cluster.FirstIndex, Cluster.NumTriangles, bDeformed});
+				}
+			}
+
+			//Fold the short static runs into the deformed runs around them
+			for (int32 RunIdx = Runs.Num() - 1; RunIdx >= 0; RunIdx--)
+			{
+				FDeformMeshClusterRun& Run = Runs[RunIdx];
+				if (!Run.bDeformed && Run.NumTriangles < MinStaticRunTriangles && Runs.Num() > 1)
+				{
+					Run.bDeformed = true;
+				}
+				if (RunIdx + 1 < Runs.Num() && Runs[RunIdx + 1].bDeformed == Run.bDeformed)
+				{
+					Run.NumTriangles += Runs[RunIdx + 1].NumTriangles;
+					Runs.RemoveAt(RunIdx + 1, 1, false);
+				}
+			}
+
+			for (const FDeformMeshClusterRun& Run : Runs)
+			{
+				if (Run.bDeformed)
+				{
+					INC_DWORD_STAT_BY(STAT_DeformMesh_DeformedClusterTriangles, Run.NumTriangles);
+				}
+				else
+				{
+					INC_DWORD_STAT_BY(STAT_DeformMesh_StaticClusterTriangles, Run.NumTriangles);
+				}
+			}
+		}
+		else
+		{
+			Runs.Add({0, Section->IndexBuffer.GetNumIndices() / 3, true});
+		}
+
+		for (const FDeformMeshClusterRun& Run : Runs)
 		{
-			//Get the section's materil, or the wireframe material if we're rendering in wireframe mode
-			FMaterialRenderProxy* MaterialProxy = bWireframe
-				                                      ? WireframeMaterialInstance
-				                                      : Section->Material->GetRenderProxy();
+			//The static clusters are out of reach of every deformer, the static mesh vertex factory puts them at the same place for less work
+			const FVertexFactory* VertexFactory = Run.bDeformed ? &Section->VertexFactory : Section->StaticVertexFactory;
+			//One batch for all the views, stereo and split screen views included, unless the vertex factory fetches the primitive data from the GPU scene
+			//The collector gives such a batch an index in the primitive data of each view, so it can't be shared
+			const bool bShareAcrossViews = VertexFactory->GetPrimitiveIdStreamIndex(EVertexInputStreamType::Default) < 0;
+			FMeshBatch* Mesh = nullptr;
 
 			// For each view..
 			for (int32 ViewIndex = 0; ViewIndex < Views.Num(); ViewIndex++)
 			{
 				//Check if our mesh is visible from this view
-				if (VisibilityMap & (1 << ViewIndex))
+				if (!(VisibilityMap & (1 << ViewIndex)))
+				{
+					continue;
+				}
+
+				if (!Mesh || !bShareAcrossViews)
 				{
-					const FSceneView* View = Views[ViewIndex];
 					// Allocate a mesh batch and get a ref to the first element
-					FMeshBatch& Mesh = Collector.AllocateMesh();
-					FMeshBatchElement& BatchElement = Mesh.Elements[0];
+					Mesh = &Collector.AllocateMesh();
+					INC_DWORD_STAT(STAT_DeformMesh_MeshBatches);
+					FMeshBatchElement& BatchElement = Mesh->Elements[0];
 					//Fill this batch element with the mesh section's render data
 					BatchElement.IndexBuffer = &Section->IndexBuffer;
-					Mesh.bWireframe = bWireframe;
-					Mesh.VertexFactory = &Section->VertexFactory;
-					Mesh.MaterialRenderProxy = MaterialProxy;
-
-					//The LocalVertexFactory uses a uniform buffer to pass primitive data like the local to world transform for this frame and for the previous one
-					//Most of this data can be fetched using the helper function below
-					bool bHasPrecomputedVolumetricLightmap;
-					FMatrix PreviousLocalToWorld;
-					int32 SingleCaptureIndex;
-					bool bOutputVelocity;
-					GetScene().GetPrimitiveUniformShaderParameters_RenderThread(
-						GetPrimitiveSceneInfo(), bHasPrecomputedVolumetricLightmap, PreviousLocalToWorld,
-						SingleCaptureIndex, bOutputVelocity);
-					//Allocate a temporary primitive uniform buffer, fill it with the data and set it in the batch element
-					FDynamicPrimitiveUniformBuffer& DynamicPrimitiveUniformBuffer = Collector.AllocateOneFrameResource<
-						FDynamicPrimitiveUniformBuffer>();
-					DynamicPrimitiveUniformBuffer.Set(GetLocalToWorld(), PreviousLocalToWorld, GetBounds(),
-					                                  GetLocalBounds(), true, bHasPrecomputedVolumetricLightmap,
-					                                  DrawsVelocity(), bOutputVelocity);
-					BatchElement.PrimitiveUniformBufferResource = &DynamicPrimitiveUniformBuffer.UniformBuffer;
+					Mesh->bWireframe = bWireframe;
+					Mesh->VertexFactory = VertexFactory;
+					Mesh->MaterialRenderProxy = MaterialProxy;
+					BatchElement.PrimitiveUniformBufferResource = &DynamicPrimitiveUniformBuffer->UniformBuffer;
 					BatchElement.PrimitiveIdMode = PrimID_DynamicPrimitiveShaderData;
 
 					//Additional data 
-					BatchElement.FirstIndex = 0;
-					BatchElement.NumPrimitives = Section->IndexBuffer.GetNumIndices() / 3;
+					BatchElement.FirstIndex = Run.FirstIndex;
+					BatchElement.NumPrimitives = Run.NumTriangles;
 					BatchElement.MinVertexIndex = 0;
 					BatchElement.MaxVertexIndex = Section->MaxVertexIndex;
-					Mesh.ReverseCulling = IsLocalToWorldDeterminantNegative();
-					Mesh.Type = PT_TriangleList;
-					Mesh.DepthPriorityGroup = SDPG_World;
-					Mesh.bCanApplyViewModeOverrides = false;
-
-					//Add the batch to the collector
-					Collector.AddMesh(ViewIndex, Mesh);
+					Mesh->ReverseCulling = IsLocalToWorldDeterminantNegative();
+					Mesh->Type = PT_TriangleList;
+					Mesh->DepthPriorityGroup = SDPG_World;
+					Mesh->bCanApplyViewModeOverrides = false;
 				}
+
+				//Add the batch to the collector
+				Collector.AddMesh(ViewIndex, *Mesh);
+				INC_DWORD_STAT(STAT_DeformMesh_SubmittedMeshBatches);
 			}
 		}
 	}
 }
 
+void FDeformMeshSceneProxy::DrawStaticElements(FStaticPrimitiveDrawInterface* PDI)
+{
+	//A baked section is drawn like a static mesh, from its baked positions and the index buffer of its static mesh
+	//The evicted deform resources aren't needed for that, and the component sends a transform update to gather these again when a bake or its visibility changes
+	for (TConstSetBitIterator<> BakedIt(SectionBaked); BakedIt; ++BakedIt)
+	{
+		const int32 SectionIdx = BakedIt.GetIndex();
+		if (!SectionVisibility[SectionIdx])
+		{
+			continue;
+		}
+
+		const FDeformMeshSectionProxy& Section = Sections[SectionIdx];
+		const FRawStaticIndexBuffer* IndexBuffer = SectionSources[SectionIdx].SourceIndices;
+
+		FMeshBatch Mesh;
+		FMeshBatchElement& BatchElement = Mesh.Elements[0];
+		BatchElement.IndexBuffer = IndexBuffer;
+		Mesh.VertexFactory = SectionBakes[SectionIdx]->GetVertexFactory();
+		Mesh.MaterialRenderProxy = Section.Material->GetRenderProxy();
+		BatchElement.PrimitiveUniformBuffer = GetUniformBuffer();
+		BatchElement.FirstIndex = 0;
+		BatchElement.NumPrimitives = IndexBuffer->GetNumIndices() / 3;
+		BatchElement.MinVertexIndex = 0;
+		BatchElement.MaxVertexIndex = Section.MaxVertexIndex;
+		Mesh.ReverseCulling = IsLocalToWorldDeterminantNegative();
+		Mesh.Type = PT_TriangleList;
+		Mesh.DepthPriorityGroup = SDPG_World;
+		Mesh.LODIndex = 0;
+		Mesh.CastShadow = true;
+		PDI->DrawMesh(Mesh, FLT_MAX);
+	}
+}
+
 FPrimitiveViewRelevance FDeformMeshSceneProxy::GetViewRelevance(const FSceneView* View) const
 {
 	FPrimitiveViewRelevance Result;
 	Result.bDrawRelevance = IsShown(View);
 	Result.bShadowRelevance = IsShadowCast(View);
-	Result.bDynamicRelevance = true;
+	Result.bStaticRelevance = bHasBakedSections;
+	Result.bDynamicRelevance = bHasDynamicSections;
 	Result.bRenderInMainPass = ShouldRenderInMainPass();
 	Result.bUsesLightingChannels = GetLightingChannelMask() != GetDefaultLightingChannelMask();
 	Result.bRenderCustomDepth = ShouldRenderCustomDepth();
@@ -290,7 +901,11 @@ uint32 FDeformMeshSceneProxy::GetMemoryFootprint() const
 
 uint32 FDeformMeshSceneProxy::GetAllocatedSize() const
 {
-	return (FPrimitiveSceneProxy::GetAllocatedSize());
+	return (FPrimitiveSceneProxy::GetAllocatedSize() + Sections.Num() * sizeof(FDeformMeshSectionProxy) +
+		DeformTransforms.GetAllocatedSize() + SectionVisibility.GetAllocatedSize() + DeformFields.GetAllocatedSize() + DeformFieldRanges.GetAllocatedSize() +
+		SectionResidency.GetAllocatedSize() + SectionLastRenderTime.GetAllocatedSize() + SectionResourceBytes.GetAllocatedSize() +
+		SectionSources.GetAllocatedSize() + SectionMaterials.GetAllocatedSize() +
+		SectionBakes.GetAllocatedSize() + SectionBaked.GetAllocatedSize());
 }
 
 FShaderResourceViewRHIRef& FDeformMeshSceneProxy::GetDeformTransformsSRV()
@@ -298,6 +913,11 @@ FShaderResourceViewRHIRef& FDeformMeshSceneProxy::GetDeformTransformsSRV()
 	return DeformTransformsSRV;
 }
 
+FShaderResourceViewRHIRef& FDeformMeshSceneProxy::GetDeformFieldsSRV()
+{
+	return DeformFieldsSRV;
+}
+
 SIZE_T FDeformMeshSceneProxy::GetTypeHash() const
 {
 	static size_t UniquePointer;
@@ -0,0 +1,317 @@
+﻿// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "DeformMeshSectionBVH.h"
+#include "Algo/Sort.h"
+
+/* Leaves are not split further below this number of triangles*/
+static const int32 MaxLeafTriangles = 4;
+
+/* Slab test of a segment against a box, OutEntry is the time at which the segment enters the box*/
+static FORCEINLINE bool IntersectSegmentBox(const FBox& Box, const FVector& Start, const FVector& InvDir, float MaxTime, float& OutEntry)
+{
+	const FVector T0 = (Box.Min - Start) * InvDir;
+	const FVector T1 = (Box.Max - Start) * InvDir;
+	const FVector TMin = T0.ComponentMin(T1);
+	const FVector TMax = T0.ComponentMax(T1);
+
+	OutEntry = FMath::Max(FMath::Max3(TMin.X, TMin.Y, TMin.Z), 0.f);
+	const float Exit = FMath::Min(FMath::Min3(TMax.X, TMax.Y, TMax.Z), MaxTime);
+	return OutEntry <= Exit;
+}
+
+/* Moller-Trumbore segment triangle intersection, double sided*/
+static FORCEINLINE bool IntersectSegmentTriangle(const FVector& Start, const FVector& Dir, const FVector& A, const FVector& B,
+                                                 const FVector& C, float& OutTime)
+{
+	const FVector E1 = B - A;
+	const FVector E2 = C - A;
+	const FVector P = Dir ^ E2;
+	const float Det = E1 | P;
+	if (FMath::Abs(Det) < SMALL_NUMBER)
+	{
+		return false;
+	}
+
+	const float InvDet = 1.f / Det;
+	const FVector T = Start - A;
+	const float U = (T | P) * InvDet;
+	if (U < 0.f || U > 1.f)
+	{
+		return false;
+	}
+
+	const FVector Q = T ^ E1;
+	const float V = (Dir | Q) * InvDet;
+	if (V < 0.f || U + V > 1.f)
+	{
+		return false;
+	}
+
+	OutTime = (E2 | Q) * InvDet;
+	return OutTime >= 0.f;
+}
+
+FBox FDeformMeshSectionBVH::GetTriangleBounds(int32 Triangle) const
+{
+	FBox Bounds(ForceInit);
+	Bounds += Positions[Indices[Triangle * 3 + 0]];
+	Bounds += Positions[Indices[Triangle * 3 + 1]];
+	Bounds += Positions[Indices[Triangle * 3 + 2]];
+	return Bounds;
+}
+
+void FDeformMeshSectionBVH::Build(const TArray<uint32>& SourceIndices, TArray<FVector>&& InitialPositions)
+{
+	Positions = MoveTemp(InitialPositions);
+	Indices = SourceIndices;
+	Nodes.Reset();
+
+	const int32 NumTriangles = Indices.Num() / 3;
+	if (NumTriangles == 0)
+	{
+		return;
+	}
+
+	TArray<FVector> Centroids;
+	Centroids.SetNumUninitialized(NumTriangles);
+	TriangleIds.SetNumUninitialized(NumTriangles);
+	for (int32 Triangle = 0; Triangle < NumTriangles; Triangle++)
+	{
+		TriangleIds[Triangle] = Triangle;
+		Centroids[Triangle] = (Positions[Indices[Triangle * 3 + 0]] + Positions[Indices[Triangle * 3 + 1]] + Positions[Indices[Triangle * 3 + 2]]) / 3.f;
+	}
+
+	Nodes.AddUninitialized(1);
+	BuildNode(0, 0, NumTriangles, Centroids);
+
+	//Sort the triangles in leaf order, so we don't need the indirection when tracing
+	TArray<uint32> SortedIndices;
+	SortedIndices.SetNumUninitialized(Indices.Num());
+	for (int32 Triangle = 0; Triangle < NumTriangles; Triangle++)
+	{
+		const int32 SourceTriangle = TriangleIds[Triangle];
+		SortedIndices[Triangle * 3 + 0] = Indices[SourceTriangle * 3 + 0];
+		SortedIndices[Triangle * 3 + 1] = Indices[SourceTriangle * 3 + 1];
+		SortedIndices[Triangle * 3 + 2] = Indices[SourceTriangle * 3 + 2];
+	}
+	Indices = MoveTemp(SortedIndices);
+
+	//Compute the node bounds with the sorted triangles
+	RefitBounds();
+}
+
+void FDeformMeshSectionBVH::BuildNode(int32 NodeIndex, int32 FirstTriangle, int32 NumTriangles, const TArray<FVector>& Centroids)
+{
+	FBox CentroidBounds(ForceInit);
+	for (int32 Triangle = FirstTriangle; Triangle < FirstTriangle + NumTriangles; Triangle++)
+	{
+		CentroidBounds += Centroids[TriangleIds[Triangle]];
+	}
+
+	//Split along the largest axis of the centroids
+	const FVector Extent = CentroidBounds.GetSize();
+	const int32 Axis = Extent.X >= Extent.Y ? (Extent.X >= Extent.Z ? 0 : 2) : (Extent.Y >= Extent.Z ? 1 : 2);
+
+	if (NumTriangles <= MaxLeafTriangles || Extent[Axis] <= KINDA_SMALL_NUMBER)
+	{
+		Nodes[NodeIndex].FirstChildOrTriangle = FirstTriangle;
+		Nodes[NodeIndex].NumTriangles = NumTriangles;
+		return;
+	}
+
+	//Median split
+	TArrayView<int32> Range(TriangleIds.GetData() + FirstTriangle, NumTriangles);
+	Algo::Sort(Range, [&Centroids, Axis](int32 A, int32 B)
+	{
+		return Centroids[A][Axis] < Centroids[B][Axis];
+	});
+
+	//Both children are allocated together, the right child is always next to the left one
+	const int32 ChildIndex = Nodes.AddUninitialized(2);
+	Nodes[NodeIndex].FirstChildOrTriangle = ChildIndex;
+	Nodes[NodeIndex].NumTriangles = 0;
+
+	const int32 NumLeft = NumTriangles / 2;
+	BuildNode(ChildIndex, FirstTriangle, NumLeft, Centroids);
+	BuildNode(ChildIndex + 1, FirstTriangle + NumLeft, NumTriangles - NumLeft, Centroids);
+}
+
+void FDeformMeshSectionBVH::Refit(TArray<FVector>&& NewPositions)
+{
+	check(NewPositions.Num() == Positions.Num());
+	Positions = MoveTemp(NewPositions);
+	RefitBounds();
+}
+
+void FDeformMeshSectionBVH::RefitBounds()
+{
+	//Children are always stored after their parent, so walking backward refits the tree bottom up
+	for (int32 NodeIndex = Nodes.Num() - 1; NodeIndex >= 0; NodeIndex--)
+	{
+		FNode& Node = Nodes[NodeIndex];
+		if (Node.NumTriangles > 0)
+		{
+			Node.Bounds.Init();
+			for (int32 Triangle = Node.FirstChildOrTriangle; Triangle < Node.FirstChildOrTriangle + Node.NumTriangles; Triangle++)
+			{
+				Node.Bounds += GetTriangleBounds(Triangle);
+			}
+		}
+		else
+		{
+			Node.Bounds = Nodes[Node.FirstChildOrTriangle].Bounds + Nodes[Node.FirstChildOrTriangle + 1].Bounds;
+		}
+	}
+}
+
+bool FDeformMeshSectionBVH::LineTrace(const FVector& Start, const FVector& End, float& InOutTime, FVector& OutNormal,
+                                      int32& OutTriangle) const
+{
+	if (Nodes.Num() == 0)
+	{
+		return false;
+	}
+
+	const FVector Dir = End - Start;
+	const FVector InvDir(Dir.X != 0.f ? 1.f / Dir.X : BIG_NUMBER,
+	                     Dir.Y != 0.f ? 1.f / Dir.Y : BIG_NUMBER,
+	                     Dir.Z != 0.f ? 1.f / Dir.Z : BIG_NUMBER);
+
+	bool bHit = false;
+	TArray<int32, TInlineAllocator<64>> Stack;
+	Stack.Add(0);
+
+	while (Stack.Num() > 0)
+	{
+		const FNode& Node = Nodes[Stack.Pop(false)];
+		float Entry;
+		if (!IntersectSegmentBox(Node.Bounds, Start, InvDir, InOutTime, Entry))
+		{
+			continue;
+		}
+
+		if (Node.NumTriangles > 0)
+		{
+			for (int32 Triangle = Node.FirstChildOrTriangle; Triangle < Node.FirstChildOrTriangle + Node.NumTriangles; Triangle++)
+			{
+				const FVector& A = Positions[Indices[Triangle * 3 + 0]];
+				const FVector& B = Positions[Indices[Triangle * 3 + 1]];
+				const FVector& C = Positions[Indices[Triangle * 3 + 2]];
+				float Time;
+				if (IntersectSegmentTriangle(Start, Dir, A, B, C, Time) && Time < InOutTime)
+				{
+					InOutTime = Time;
+					OutNormal = ((B - A) ^ (C - A)).GetSafeNormal();
+					//Double sided, the normal always faces the segment
+					if ((OutNormal | Dir) > 0.f)
+					{
+						OutNormal = -OutNormal;
+					}
+					OutTriangle = TriangleIds[Triangle];
+					bHit = true;
+				}
+			}
+		}
+		else
+		{
+			//Visit the nearest child first so the farther one can be culled by the closest hit
+			const int32 Left = Node.FirstChildOrTriangle;
+			float LeftEntry, RightEntry;
+			const bool bLeft = IntersectSegmentBox(Nodes[Left].Bounds, Start, InvDir, InOutTime, LeftEntry);
+			const bool bRight = IntersectSegmentBox(Nodes[Left + 1].Bounds, Start, InvDir, InOutTime, RightEntry);
+			if (bLeft && bRight)
+			{
+				Stack.Add(LeftEntry <= RightEntry ? Left + 1 : Left);
+				Stack.Add(LeftEntry <= RightEntry ? Left : Left + 1);
+			}
+			else if (bLeft || bRight)
+			{
+				Stack.Add(bLeft ? Left : Left + 1);
+			}
+		}
+	}
+	return bHit;
+}
+
+bool FDeformMeshSectionBVH::OverlapSphere(const FVector& Center, float Radius) const
+{
+	if (Nodes.Num() == 0)
+	{
+		return false;
+	}
+
+	const float RadiusSquared = FMath::Square(Radius);
+	TArray<int32, TInlineAllocator<64>> Stack;
+	Stack.Add(0);
+
+	while (Stack.Num() > 0)
+	{
+		const FNode& Node = Nodes[Stack.Pop(false)];
+		if (!FMath::SphereAABBIntersection(Center, RadiusSquared, Node.Bounds))
+		{
+			continue;
+		}
+
+		if (Node.NumTriangles > 0)
+		{
+			for (int32 Triangle = Node.FirstChildOrTriangle; Triangle < Node.FirstChildOrTriangle + Node.NumTriangles; Triangle++)
+			{
+				const FVector ClosestPoint = FMath::ClosestPointOnTriangleToPoint(Center,
+					Positions[Indices[Triangle * 3 + 0]], Positions[Indices[Triangle * 3 + 1]], Positions[Indices[Triangle * 3 + 2]]);
+				if (FVector::DistSquared(ClosestPoint, Center) <= RadiusSquared)
+				{
+					return true;
+				}
+			}
+		}
+		else
+		{
+			Stack.Add(Node.FirstChildOrTriangle);
+			Stack.Add(Node.FirstChildOrTriangle + 1);
+		}
+	}
+	return false;
+}
+
+bool FDeformMeshSectionBVH::OverlapBox(const FBox& Box) const
+{
+	if (Nodes.Num() == 0)
+	{
+		return false;
+	}
+
+	TArray<int32, TInlineAllocator<64>> Stack;
+	Stack.Add(0);
+
+	while (Stack.Num() > 0)
+	{
+		const FNode& Node = Nodes[Stack.Pop(false)];
+		if (!Node.Bounds.Intersect(Box))
+		{
+			continue;
+		}
+
+		if (Node.NumTriangles > 0)
+		{
+			for (int32 Triangle = Node.FirstChildOrTriangle; Triangle < Node.FirstChildOrTriangle + Node.NumTriangles; Triangle++)
+			{
+				if (GetTriangleBounds(Triangle).Intersect(Box))
+				{
+					return true;
+				}
+			}
+		}
+		else
+		{
+			Stack.Add(Node.FirstChildOrTriangle);
+			Stack.Add(Node.FirstChildOrTriangle + 1);
+		}
+	}
+	return false;
+}
+
+uint32 FDeformMeshSectionBVH::GetAllocatedSize() const
+{
+	return Nodes.GetAllocatedSize() + Indices.GetAllocatedSize() + TriangleIds.GetAllocatedSize() + Positions.GetAllocatedSize();
+}
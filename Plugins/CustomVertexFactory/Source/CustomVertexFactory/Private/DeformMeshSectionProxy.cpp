@@ -4,7 +4,10 @@
 #include "DeformMeshSectionProxy.h"
 
 FDeformMeshSectionProxy::FDeformMeshSectionProxy(ERHIFeatureLevel::Type InFeatureLevel): Material(nullptr),
-	VertexFactory(InFeatureLevel), bSectionVisible(true)
+	VertexFactory(InFeatureLevel),
+	MaxVertexIndex(0),
+	Clusters(nullptr),
+	StaticVertexFactory(nullptr)
 {
 }
 
@@ -2,7 +2,8 @@
 #include "DeformMeshVertexFactory.h"
 
 FDeformMeshVertexFactory::FDeformMeshVertexFactory(ERHIFeatureLevel::Type InFeatureLevel): FLocalVertexFactory(
-	InFeatureLevel, "FDeformMeshVertexFactory")
+	InFeatureLevel, "FDeformMeshVertexFactory"), FieldOffset(0), FieldCount(0),
+	PositionScale(1.f, 1.f, 1.f, 1.f), PositionBias(0.f, 0.f, 0.f, 0.f)
 {
 	bSupportsManualVertexFetch = false;
 }
@@ -69,11 +70,23 @@ void FDeformMeshVertexFactory::InitRHI()
 	check(IsValidRef(GetDeclaration()));
 }
 
-void FDeformMeshVertexFactory::SetTransformIndex(uint16 Index)
+void FDeformMeshVertexFactory::SetTransformIndex(uint32 Index)
 {
 	TransformIndex = Index;
 }
 
+void FDeformMeshVertexFactory::SetFieldRange(uint32 Offset, uint32 Count)
+{
+	FieldOffset = Offset;
+	FieldCount = Count;
+}
+
+void FDeformMeshVertexFactory::SetPositionDequantization(const FVector4& Scale, const FVector4& Bias)
+{
+	PositionScale = Scale;
+	PositionBias = Bias;
+}
+
 void FDeformMeshVertexFactory::SetSceneProxy(FDeformMeshSceneProxy * Proxy)
 {
 	SceneProxy = Proxy;
@@ -18,6 +18,10 @@ void FDeformMeshVertexFactoryShaderParameters::Bind(const FShaderParameterMap& P
 {
 	TransformIndex.Bind(ParameterMap, TEXT("DMTransformIndex"), SPF_Optional);
 	TransformsSRV.Bind(ParameterMap, TEXT("DMTransforms"), SPF_Optional);
+	FieldRange.Bind(ParameterMap, TEXT("DMFieldRange"), SPF_Optional);
+	FieldsSRV.Bind(ParameterMap, TEXT("DMFields"), SPF_Optional);
+	PositionScale.Bind(ParameterMap, TEXT("DMPositionScale"), SPF_Optional);
+	PositionBias.Bind(ParameterMap, TEXT("DMPositionBias"), SPF_Optional);
 }
 
 void FDeformMeshVertexFactoryShaderParameters::GetElementShaderBindings(const FSceneInterface* Scene,
@@ -46,6 +50,11 @@ void FDeformMeshVertexFactoryShaderParameters::GetElementShaderBindings(const FS
 	const uint32 Index = DeformMeshVertexFactory->TransformIndex;
 	ShaderBindings.Add(TransformIndex, Index);
 	ShaderBindings.Add(TransformsSRV, DeformMeshVertexFactory->SceneProxy->GetDeformTransformsSRV());
+	const FIntPoint Range(DeformMeshVertexFactory->FieldOffset, DeformMeshVertexFactory->FieldCount);
+	ShaderBindings.Add(FieldRange, Range);
+	ShaderBindings.Add(FieldsSRV, DeformMeshVertexFactory->SceneProxy->GetDeformFieldsSRV());
+	ShaderBindings.Add(PositionScale, DeformMeshVertexFactory->PositionScale);
+	ShaderBindings.Add(PositionBias, DeformMeshVertexFactory->PositionBias);
 }
 
 IMPLEMENT_TYPE_LAYOUT(FDeformMeshVertexFactoryShaderParameters);
@@ -0,0 +1,84 @@
+﻿// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "DeformMeshAssembly.h"
+#include "DeformMeshComponent.h"
+#include "Engine/StaticMesh.h"
+#include "HAL/FileManager.h"
+#include "Misc/AutomationTest.h"
+#include "Misc/PackageName.h"
+#include "Misc/Paths.h"
+#include "UObject/Package.h"
+
+#if WITH_DEV_AUTOMATION_TESTS && WITH_EDITOR
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FDeformMeshAssemblyTest, "CustomVertexFactory.DeformMesh.Assembly",
+                                 EAutomationTestFlags::EditorContext | EAutomationTestFlags::EngineFilter)
+
+bool FDeformMeshAssemblyTest::RunTest(const FString& Parameters)
+{
+	UStaticMesh* Cube = LoadObject<UStaticMesh>(nullptr, TEXT("/Engine/BasicShapes/Cube.Cube"));
+	if (!TestNotNull(TEXT("Cube mesh"), Cube))
+	{
+		return false;
+	}
+
+	//A root section, a hidden child section and a hole in the section indices
+	UDeformMeshComponent* Source = NewObject<UDeformMeshComponent>(GetTransientPackage());
+	Source->CreateMeshSection(0, Cube, FTransform(FVector(100.f, 0.f, 0.f)));
+	Source->CreateMeshSection(2, Cube, FTransform(FRotator(0.f, 45.f, 0.f), FVector(0.f, 50.f, 0.f), FVector(2.f)));
+	Source->SetMeshSectionParent(2, 0);
+	Source->SetMeshSectionVisible(2, false);
+	Source->UpdateSectionHierarchy();
+
+	//Capture in a new asset and save it
+	UPackage* Package = CreatePackage(TEXT("/Temp/DeformMeshAssemblyTest"));
+	UDeformMeshAssembly* Assembly = NewObject<UDeformMeshAssembly>(Package, TEXT("Assembly"), RF_Public | RF_Standalone);
+	Assembly->CaptureComponent(Source, EDeformMeshDerivedDataFlags::OptimizedIndices);
+
+	const FString Filename = FPaths::Combine(FPaths::AutomationTransientDir(), TEXT("DeformMeshAssemblyTest") + FPackageName::GetAssetPackageExtension());
+	const bool bSaved = UPackage::SavePackage(Package, Assembly, RF_Public | RF_Standalone, *Filename, GError, nullptr, false, true, SAVE_NoError);
+	Assembly->ClearFlags(RF_Public | RF_Standalone);
+	if (!TestTrue(TEXT("Assembly saved"), bSaved))
+	{
+		return false;
+	}
+
+	//Load the saved file in another package, so the assembly goes through Serialize and PostLoad
+	UPackage* LoadedPackage = LoadPackage(CreatePackage(TEXT("/Temp/DeformMeshAssemblyTestLoaded")), *Filename, LOAD_None);
+	UDeformMeshAssembly* LoadedAssembly = LoadedPackage ? FindObject<UDeformMeshAssembly>(LoadedPackage, TEXT("Assembly")) : nullptr;
+	IFileManager::Get().Delete(*Filename);
+	if (!TestNotNull(TEXT("Loaded assembly"), LoadedAssembly))
+	{
+		return false;
+	}
+	LoadedAssembly->ClearFlags(RF_Public | RF_Standalone);
+	TestEqual(TEXT("Loaded sections"), LoadedAssembly->GetSections().Num(), 2);
+	TestEqual(TEXT("Loaded meshes"), LoadedAssembly->GetMeshes().Num(), 1);
+
+	//The component filled from the loaded assembly has the sections of the captured one
+	UDeformMeshComponent* Target = NewObject<UDeformMeshComponent>(GetTransientPackage());
+	Target->InitFromAssembly(LoadedAssembly);
+	TestEqual(TEXT("Number of sections"), Target->GetNumSections(), Source->GetNumSections());
+	TestFalse(TEXT("The hole stays free"), Target->IsValidSectionHandle(Target->GetSectionHandle(1)));
+	for (const int32 SectionIndex : {0, 2})
+	{
+		FDeformMeshSection Expected;
+		FDeformMeshSection Actual;
+		if (!TestTrue(FString::Printf(TEXT("Section %d exists"), SectionIndex), Target->GetDeformMeshSection(SectionIndex, Actual)))
+		{
+			continue;
+		}
+		Source->GetDeformMeshSection(SectionIndex, Expected);
+
+		TestTrue(FString::Printf(TEXT("Section %d mesh"), SectionIndex), Actual.StaticMesh == Expected.StaticMesh);
+		TestTrue(FString::Printf(TEXT("Section %d transform"), SectionIndex), Actual.DeformTransform.Equals(Expected.DeformTransform, 0.f));
+		TestTrue(FString::Printf(TEXT("Section %d box"), SectionIndex), Actual.SectionLocalBox == Expected.SectionLocalBox);
+		TestTrue(FString::Printf(TEXT("Section %d visibility"), SectionIndex), Actual.bSectionVisible == Expected.bSectionVisible);
+		TestEqual(FString::Printf(TEXT("Section %d parent"), SectionIndex), Target->GetMeshSectionParent(SectionIndex), Source->GetMeshSectionParent(SectionIndex));
+	}
+
+	return true;
+}
+
+#endif
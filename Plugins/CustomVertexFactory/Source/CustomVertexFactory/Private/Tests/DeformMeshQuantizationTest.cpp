@@ -0,0 +1,80 @@
+﻿// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "DeformMeshDerivedData.h"
+#include "Math/RandomStream.h"
+#include "Misc/AutomationTest.h"
+
+#if WITH_DEV_AUTOMATION_TESTS
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FDeformMeshQuantizationTest, "CustomVertexFactory.DeformMesh.Quantization",
+                                 EAutomationTestFlags::ApplicationContextMask | EAutomationTestFlags::EngineFilter)
+
+/* Encode and decode positions spread in the box, and check that each axis stays within the expected error*/
+static void TestQuantizationBox(FAutomationTestBase& Test, const FString& What, const FBox& Box, FRandomStream& RandomStream)
+{
+	FVector4 Scale;
+	FVector4 Bias;
+	DeformMeshQuantization::GetDequantization(Box, Scale, Bias);
+	const FVector MaxError = DeformMeshQuantization::GetMaxDecodeError(Box);
+
+	//The corners and the center, then random positions
+	TArray<FVector> Positions = {Box.Min, Box.Max, Box.GetCenter()};
+	for (int32 PositionIdx = 0; PositionIdx < 256; PositionIdx++)
+	{
+		Positions.Add(FVector(RandomStream.FRandRange(Box.Min.X, Box.Max.X),
+		                      RandomStream.FRandRange(Box.Min.Y, Box.Max.Y),
+		                      RandomStream.FRandRange(Box.Min.Z, Box.Max.Z)));
+	}
+
+	FVector MaxObservedError = FVector::ZeroVector;
+	for (const FVector& Position : Positions)
+	{
+		const FDeformMeshPackedPosition Packed = DeformMeshQuantization::Encode(Position, Box);
+		MaxObservedError = MaxObservedError.ComponentMax((DeformMeshQuantization::Decode(Packed, Scale, Bias) - Position).GetAbs());
+	}
+
+	Test.TestTrue(FString::Printf(TEXT("%s: error %s within %s"), *What, *MaxObservedError.ToString(), *MaxError.ToString()),
+	              MaxObservedError.X <= MaxError.X && MaxObservedError.Y <= MaxError.Y && MaxObservedError.Z <= MaxError.Z);
+}
+
+bool FDeformMeshQuantizationTest::RunTest(const FString& Parameters)
+{
+	FRandomStream RandomStream(0x5EED);
+
+	//The corners of the box are the ends of the 16 bit range
+	const FBox UnitBox(FVector(-1.f), FVector(1.f));
+	const FDeformMeshPackedPosition MinPacked = DeformMeshQuantization::Encode(UnitBox.Min, UnitBox);
+	const FDeformMeshPackedPosition MaxPacked = DeformMeshQuantization::Encode(UnitBox.Max, UnitBox);
+	TestTrue(TEXT("Min corner encodes to 0"), MinPacked.X == 0 && MinPacked.Y == 0 && MinPacked.Z == 0);
+	TestTrue(TEXT("Max corner encodes to 65535"), MaxPacked.X == 65535 && MaxPacked.Y == 65535 && MaxPacked.Z == 65535);
+	TestEqual(TEXT("W is always 1"), (int32)MaxPacked.W, 65535);
+
+	//Positions outside of the box are clamped to it
+	const FDeformMeshPackedPosition OutsidePacked = DeformMeshQuantization::Encode(FVector(-2.f, 2.f, 0.f), UnitBox);
+	TestTrue(TEXT("Outside positions are clamped"), OutsidePacked.X == 0 && OutsidePacked.Y == 65535);
+
+	TestQuantizationBox(*this, TEXT("Unit box"), UnitBox, RandomStream);
+	for (int32 BoxIdx = 0; BoxIdx < 16; BoxIdx++)
+	{
+		const FVector Center = RandomStream.VRand() * RandomStream.FRandRange(0.f, 1000.f);
+		const FVector Extent(RandomStream.FRandRange(0.01f, 500.f), RandomStream.FRandRange(0.01f, 500.f), RandomStream.FRandRange(0.01f, 500.f));
+		TestQuantizationBox(*this, FString::Printf(TEXT("Random box %d"), BoxIdx), FBox(Center - Extent, Center + Extent), RandomStream);
+	}
+
+	//A flat mesh has a zero extent axis, it encodes to 0 and decodes to the box exactly
+	const FBox FlatBox(FVector(-50.f, -50.f, 10.f), FVector(50.f, 50.f, 10.f));
+	TestEqual(TEXT("Zero extent axis encodes to 0"), (int32)DeformMeshQuantization::Encode(FVector(0.f, 0.f, 10.f), FlatBox).Z, 0);
+	TestEqual(TEXT("Zero extent axis has no error"), DeformMeshQuantization::GetMaxError(FlatBox).Z, 0.f);
+	TestQuantizationBox(*this, TEXT("Flat box"), FlatBox, RandomStream);
+	TestQuantizationBox(*this, TEXT("Point box"), FBox(FVector(3.f, -7.f, 1.f), FVector(3.f, -7.f, 1.f)), RandomStream);
+
+	//Far from the origin, the float rounding of the decode dominates for small boxes
+	TestQuantizationBox(*this, TEXT("Large offset"), FBox(FVector(1e5f, -1e5f, 5e4f), FVector(1e5f + 200.f, -1e5f + 300.f, 5e4f + 100.f)), RandomStream);
+	TestQuantizationBox(*this, TEXT("Large offset and extent"), FBox(FVector(-1e5f), FVector(1e5f)), RandomStream);
+	TestQuantizationBox(*this, TEXT("Large offset, flat"), FBox(FVector(1e5f, 1e5f, -2e5f), FVector(1e5f + 50.f, 1e5f, -2e5f + 50.f)), RandomStream);
+
+	return true;
+}
+
+#endif
@@ -0,0 +1,108 @@
+﻿// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "DeformMeshField.h"
+#include "Subsystems/WorldSubsystem.h"
+#include "Tickable.h"
+#include "DeformFieldSubsystem.generated.h"
+
+class UDeformMeshComponent;
+
+/**
+ * World level registry of spherical deform fields
+ * Fields and registered deform mesh components are binned in uniform grids, so each field is only tested against the components and sections that it overlaps
+ * The assignment is incremental, only the components that changed and the ones overlapped by the fields that changed are assigned again
+ */
+UCLASS()
+class CUSTOMVERTEXFACTORY_API UDeformFieldSubsystem : public UWorldSubsystem, public FTickableGameObject
+{
+	GENERATED_BODY()
+private:
+	/** Cells covered by a field or a component, the ones covering too many cells go in the overflow cell instead */
+	struct FCellRange
+	{
+		FIntVector MinCell;
+		FIntVector MaxCell;
+
+		bool operator==(const FCellRange& Other) const
+		{
+			return MinCell == Other.MinCell && MaxCell == Other.MaxCell;
+		}
+	};
+
+	/** All the fields of this world, the index in the sparse array is the field id */
+	TSparseArray<FDeformMeshField> Fields;
+
+	/** Cells covered by each field, by field id */
+	TSparseArray<FCellRange> FieldCells;
+
+	/** Components that can be deformed by the fields, the index in the sparse array is the component id */
+	TSparseArray<TWeakObjectPtr<UDeformMeshComponent>> Components;
+
+	/** Cells covered by each binned component, by component id, the components registered since the last update aren't binned yet */
+	TSparseArray<FCellRange> ComponentCells;
+
+	/** Id of each registered component */
+	TMap<TWeakObjectPtr<UDeformMeshComponent>, int32> ComponentIds;
+
+	/** Uniform grids, map a cell coordinate to the ids of the fields and of the components whose bounds overlap this cell */
+	TMap<FIntVector, TArray<int32>> FieldGrid;
+	TMap<FIntVector, TArray<int32>> ComponentGrid;
+
+	/** Components whose bounds or sections changed since the last update, they're binned and assigned again */
+	TSet<int32> DirtyComponents;
+
+	/** World boxes of the fields added, moved or removed since the last update, the components they overlap are assigned again */
+	TArray<FBox> DirtyFieldBoxes;
+
+	/** Size of a grid cell in world units */
+	float CellSize;
+
+	/** Set when the cell size changed, everything is binned again */
+	bool bGridDirty;
+
+private:
+	FIntVector GetCell(const FVector& Location) const;
+	FCellRange GetCellRange(const FBox& WorldBox) const;
+
+	/* Move the field or the component to the cells covered by its current bounds*/
+	void BinField(int32 FieldId);
+	void UnbinField(int32 FieldId);
+	void BinComponent(int32 ComponentId);
+	void RemoveComponent(int32 ComponentId);
+
+	/* Bin everything again, after the cell size changed*/
+	void RebuildGrids();
+
+	/* Send its overlapping fields to the component, the component skips the update if they didn't change*/
+	void AssignComponentFields(UDeformMeshComponent* Component, int32 ComponentId, TArray<int32>& LastTestedComponent) const;
+
+	/* Assign the fields of the dirty components and of the components overlapped by the dirty fields*/
+	void AssignFields();
+
+public:
+	UDeformFieldSubsystem();
+
+	/* Add a new field, returns the id used to update or remove it*/
+	int32 AddDeformField(const FVector& Position, const FTransform& Transform, float Radius);
+	void UpdateDeformField(int32 FieldId, const FVector& Position, const FTransform& Transform, float Radius);
+	void RemoveDeformField(int32 FieldId);
+	int32 GetNumDeformFields() const;
+
+	void SetCellSize(float NewCellSize);
+
+	void RegisterComponent(UDeformMeshComponent* Component);
+	void UnregisterComponent(UDeformMeshComponent* Component);
+
+	/* Called by the components when their bounds or sections change, only the dirty components are assigned again*/
+	void MarkComponentDirty(UDeformMeshComponent* Component);
+
+	//~ FTickableGameObject interface
+	virtual void Tick(float DeltaTime) override;
+	virtual ETickableTickType GetTickableTickType() const override;
+	virtual bool IsTickable() const override;
+	virtual UWorld* GetTickableGameObjectWorld() const override;
+	virtual TStatId GetStatId() const override;
+};
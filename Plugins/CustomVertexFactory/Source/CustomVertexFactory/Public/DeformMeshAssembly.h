@@ -0,0 +1,74 @@
+﻿// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "DeformMeshDerivedData.h"
+#include "Engine/DataAsset.h"
+#include "DeformMeshAssembly.generated.h"
+
+class UDeformMeshComponent;
+class UMaterialInterface;
+class UStaticMesh;
+
+/**
+ * A section of a UDeformMeshAssembly, plain data so the whole table is read in one block
+ */
+struct FDeformMeshAssemblySection
+{
+	int32 SectionIndex;
+	/** Index in the meshes of the assembly */
+	int32 MeshIndex;
+	/** Index in the materials of the assembly, INDEX_NONE for no material */
+	int32 MaterialIndex;
+	/** Section index of the parent, INDEX_NONE for a root section */
+	int32 ParentSectionIndex;
+	/** Deform transform and transform relative to the parent, both transposed like in the component */
+	FMatrix DeformTransform;
+	FMatrix LocalTransform;
+	FBox LocalBox;
+	bool bVisible;
+
+	friend FArchive& operator<<(FArchive& Ar, FDeformMeshAssemblySection& Section)
+	{
+		return Ar << Section.SectionIndex << Section.MeshIndex << Section.MaterialIndex << Section.ParentSectionIndex
+			<< Section.DeformTransform << Section.LocalTransform << Section.LocalBox << Section.bVisible;
+	}
+};
+
+/**
+ * The sections of a UDeformMeshComponent saved as an asset, with their bounds, materials and the derived data of their meshes
+ * UDeformMeshComponent::InitFromAssembly fills a component from it in one pass, without going through the meshes
+ */
+UCLASS(BlueprintType)
+class CUSTOMVERTEXFACTORY_API UDeformMeshAssembly : public UDataAsset
+{
+	GENERATED_BODY()
+private:
+	/** The meshes used by the sections, each one once */
+	UPROPERTY(VisibleAnywhere, Category = "Deform Mesh")
+	TArray<UStaticMesh*> Meshes;
+
+	/** The materials used by the sections, each one once */
+	UPROPERTY(VisibleAnywhere, Category = "Deform Mesh")
+	TArray<UMaterialInterface*> Materials;
+
+	/** Section table, bulk serialized */
+	TArray<FDeformMeshAssemblySection> Sections;
+
+	/** Derived data of each mesh, registered on load so the components using these meshes don't build it again */
+	TArray<TSharedPtr<FDeformMeshDerivedData, ESPMode::ThreadSafe>> MeshDerivedData;
+
+public:
+	virtual void Serialize(FArchive& Ar) override;
+	virtual void PostLoad() override;
+
+#if WITH_EDITOR
+	/* Replace the content of the assembly with the sections of the component, and build the derived data of their meshes*/
+	void CaptureComponent(const UDeformMeshComponent* Component, EDeformMeshDerivedDataFlags DerivedDataFlags);
+#endif
+
+	const TArray<UStaticMesh*>& GetMeshes() const { return Meshes; }
+	const TArray<UMaterialInterface*>& GetMaterials() const { return Materials; }
+	const TArray<FDeformMeshAssemblySection>& GetSections() const { return Sections; }
+};
@@ -0,0 +1,42 @@
+﻿// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "DeformMeshField.h"
+#include "LocalVertexFactory.h"
+#include "Rendering/PositionVertexBuffer.h"
+
+struct FStaticMeshVertexBuffers;
+
+/**
+ * Positions of a section whose deformation settled, evaluated once on the CPU and drawn as a static mesh
+ * The vertex factory reads the baked positions and the other streams of the static mesh
+ */
+class CUSTOMVERTEXFACTORY_API FDeformMeshBakedSection
+{
+private:
+	FPositionVertexBuffer Positions;
+	FLocalVertexFactory VertexFactory;
+
+	/** The deform transform the positions were baked with, an update to the same transform keeps the bake */
+	FMatrix DeformTransform;
+
+	FDeformMeshBakedSection(ERHIFeatureLevel::Type InFeatureLevel, const FMatrix& InDeformTransform);
+
+public:
+	~FDeformMeshBakedSection();
+
+	/* Deform the local positions like the deform vertex factory does and bring them back to the local space, safe to call on a worker*/
+	static TArray<FVector> BakePositions(TArray<FVector>&& LocalPositions, const FMatrix& LocalToWorld, const FMatrix& DeformTransform,
+	                                     const TArray<FDeformMeshFieldGPU>& Fields);
+
+	/* Start the upload of the baked positions, the other streams are bound from the static mesh vertex buffers
+	 * The render resources are released on the render thread with the last reference*/
+	static TSharedPtr<FDeformMeshBakedSection, ESPMode::ThreadSafe> Create(ERHIFeatureLevel::Type FeatureLevel, const FMatrix& DeformTransform,
+	                                                                       TArray<FVector>&& BakedPositions, FStaticMeshVertexBuffers* VertexBuffers);
+
+	const FVertexFactory* GetVertexFactory() const { return &VertexFactory; }
+	const FMatrix& GetDeformTransform() const { return DeformTransform; }
+	uint32 GetResourceSize() const { return Positions.GetNumVertices() * sizeof(FVector); }
+};
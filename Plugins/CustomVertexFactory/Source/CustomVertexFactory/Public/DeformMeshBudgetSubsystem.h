@@ -0,0 +1,66 @@
+﻿// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Subsystems/WorldSubsystem.h"
+#include "Tickable.h"
+#include "DeformMeshBudgetSubsystem.generated.h"
+
+class UDeformMeshComponent;
+
+/**
+ * Spreads the transform updates of the deform mesh components that use the update budget over the frames
+ * Components are ranked by their screen size, the less significant ones are updated every few frames, and the total number
+ * of section updates and uploaded bytes per frame is capped. A component never waits more than MaxStarvedFrames.
+ */
+UCLASS()
+class CUSTOMVERTEXFACTORY_API UDeformMeshBudgetSubsystem : public UWorldSubsystem, public FTickableGameObject
+{
+	GENERATED_BODY()
+private:
+	struct FBudgetedComponent
+	{
+		TWeakObjectPtr<UDeformMeshComponent> Component;
+		/** Number of frames this component has been waiting with pending updates */
+		int32 FramesSinceUpdate;
+		/** Approximate screen size from the closest viewer, 1 when there's no viewer */
+		float Significance;
+	};
+
+	TArray<FBudgetedComponent> Components;
+
+	/** Maximum number of section transform updates sent per frame */
+	int32 MaxSectionUpdatesPerFrame;
+
+	/** Maximum number of structured buffer bytes uploaded per frame */
+	int32 MaxUploadBytesPerFrame;
+
+	/** Components at or above this screen size are updated every frame, smaller ones less often */
+	float FullRateScreenSize;
+
+	/** Longest update interval given to insignificant components, in frames */
+	int32 MaxUpdateInterval;
+
+	/** A component with pending updates is always updated after this number of frames, even over budget */
+	int32 MaxStarvedFrames;
+
+private:
+	void UpdateSignificance();
+
+public:
+	UDeformMeshBudgetSubsystem();
+
+	void RegisterComponent(UDeformMeshComponent* Component);
+	void UnregisterComponent(UDeformMeshComponent* Component);
+
+	void SetBudget(int32 InMaxSectionUpdatesPerFrame, int32 InMaxUploadBytesPerFrame);
+	void SetUpdateIntervals(float InFullRateScreenSize, int32 InMaxUpdateInterval, int32 InMaxStarvedFrames);
+
+	//~ FTickableGameObject interface
+	virtual void Tick(float DeltaTime) override;
+	virtual ETickableTickType GetTickableTickType() const override;
+	virtual bool IsTickable() const override;
+	virtual UWorld* GetTickableGameObjectWorld() const override;
+	virtual TStatId GetStatId() const override;
+};
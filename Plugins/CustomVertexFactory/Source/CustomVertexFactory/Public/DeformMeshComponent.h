@@ -3,10 +3,18 @@
 #pragma once
 
 #include "CoreMinimal.h"
+#include "DeformMeshBakedSection.h"
+#include "DeformMeshDerivedData.h"
+#include "DeformMeshField.h"
+#include "DeformMeshReplication.h"
 #include "DeformMeshSection.h"
+#include "DeformMeshSectionBVH.h"
+#include "Async/Future.h"
 #include "UObject/Object.h"
 #include "DeformMeshComponent.generated.h"
 
+class UDeformMeshAssembly;
+
 /**
  * 
  */
@@ -15,32 +23,344 @@ class CUSTOMVERTEXFACTORY_API UDeformMeshComponent : public UMeshComponent
 {
 	GENERATED_BODY()
 private:
-	/** Array of sections of mesh */
+	/**
+	 * The live sections of mesh are packed in parallel arrays, a section's position in these arrays changes when other sections are cleared
+	 * Loops over the transforms, the bounds or the visibility of the sections only touch the array they read
+	 */
+	UPROPERTY()
+	TArray<UStaticMesh*> SectionMeshes;
+
+	/** Deprecated, the sections by section index as they were saved before they were packed
+	 * Only filled when loading older data, Serialize moves them to the packed arrays and empties it */
 	UPROPERTY()
 	TArray<FDeformMeshSection> DeformMeshSections;
 
+	/** Deform transform of each packed section */
+	UPROPERTY()
+	TArray<FMatrix> SectionDeformTransforms;
+
+	/** Local bounding box of each packed section */
+	UPROPERTY()
+	TArray<FBox> SectionLocalBoxes;
+
+	/** Visibility of each packed section, serialized by Serialize since a bit array can't be a property */
+	TBitArray<> SectionVisibility;
+
+	/** Parent section index of each packed section, INDEX_NONE for the sections that aren't attached to another one */
+	UPROPERTY()
+	TArray<int32> SectionParents;
+
+	/** Transform of each packed section relative to its parent, transposed like the deform transforms, unused for the root sections */
+	UPROPERTY()
+	TArray<FMatrix> SectionLocalTransforms;
+
+	/** Set for the packed sections whose deform transform changed since the last hierarchy update
+	 * Bytes rather than bits, the levels are evaluated in parallel and each worker writes its own sections */
+	TArray<uint8> SectionHierarchyDirty;
+
+	/** Child sections grouped by depth in the hierarchy, each entry is the packed index of the child and of its parent */
+	TArray<TArray<FIntPoint>> SectionHierarchyLevels;
+
+	/** Set when a parent changed or the packed indices moved */
+	bool bSectionHierarchyLevelsDirty;
+
+	/** Set when a section of a hierarchy moved since the last hierarchy update */
+	bool bSectionHierarchyDirty;
+
+	/** Render data derived from the static mesh of each packed section, shared with the other sections using the same mesh */
+	TArray<TSharedPtr<FDeformMeshDerivedData, ESPMode::ThreadSafe>> SectionDerivedData;
+
+	/** Section index of each packed section */
+	UPROPERTY()
+	TArray<int32> DenseSectionSlots;
+
+	/** Slot table indexed by section index, maps a section index to its position in the packed arrays */
+	UPROPERTY()
+	TArray<FDeformMeshSectionSlot> SectionSlots;
+
+	/** Section indices that aren't used, AddMeshSection reuses them before growing the slot table */
+	UPROPERTY()
+	TArray<int32> FreeSectionSlots;
+
 	/** Local space bounds of mesh */
 	UPROPERTY()
 	FBoxSphereBounds LocalBounds;
 
+	/** Set when a section moved since the last FinishTransformsUpdate, the bounds are updated once for all the moved sections */
+	bool bLocalBoundsDirty;
+
+	/** Deform fields overlapping this component, the fields of each section are contiguous */
+	TArray<FDeformMeshFieldGPU> DeformFields;
+
+	/** For each packed section, the offset and the number of its fields in DeformFields */
+	TArray<FIntPoint> DeformFieldRanges;
+
+	/** BVH over the deformed triangles of each packed section, built on the first query and refit when the deformation changes */
+	TArray<TUniquePtr<FDeformMeshSectionBVH>> SectionBVHs;
+
+	/** Set for the packed sections whose deformation changed since their BVH was last refit */
+	TArray<uint8> SectionBVHsDirty;
+
+	/** Set by the first query, from then on FinishTransformsUpdate starts the refit of the moved sections ahead of the next one */
+	bool bSectionBVHsQueried;
+
+	/** BVHs refit on a worker, by section index since the packed index can move while it runs */
+	struct FSectionBVHRefit
+	{
+		int32 SectionIndex;
+		uint32 Generation;
+		FMatrix DeformTransform;
+		TArray<FVector> Positions;
+		/** Only copied when the BVH has to be built */
+		TArray<uint32> Indices;
+		TArray<FDeformMeshFieldGPU> Fields;
+		TUniquePtr<FDeformMeshSectionBVH> BVH;
+	};
+	TSharedPtr<TArray<FSectionBVHRefit>, ESPMode::ThreadSafe> PendingBVHRefits;
+	TFuture<void> PendingBVHRefitTask;
+
+	/** Transform updates waiting for FinishTransformsUpdate */
+	TArray<FDeformMeshTransformUpdate> PendingTransformUpdates;
+
+	/** Position of the pending update of each section in PendingTransformUpdates, a section updated twice before the send only keeps its last transform */
+	TMap<int32, int32> PendingTransformUpdateIndices;
+
+	/** When set, FinishTransformsUpdate only queues the updates and the UDeformMeshBudgetSubsystem decides when they're sent */
+	UPROPERTY(EditAnywhere, Category = "Deform Mesh")
+	bool bUseUpdateBudget;
+
+	/** Set by FinishTransformsUpdate when the send is left to the budget */
+	bool bTransformsUpdatePending;
+
+	/** When set, the transforms sent by FinishTransformsUpdate are timestamped samples that the render thread interpolates every frame */
+	UPROPERTY(EditAnywhere, Category = "Deform Mesh")
+	bool bInterpolateTransforms;
+
+	/** Expected rate of the transform samples when interpolating, in samples per second */
+	UPROPERTY(EditAnywhere, Category = "Deform Mesh", meta = (ClampMin = "1.0", EditCondition = "bInterpolateTransforms"))
+	float TransformSampleRate;
+
+	/** When set, the vertex factory fetches 16 bit positions quantized to the bounds of each mesh instead of the full precision ones */
+	UPROPERTY(EditAnywhere, Category = "Deform Mesh")
+	bool bQuantizePositions;
+
+	/** When set, the sections draw the triangles of their mesh reordered for the post-transform vertex cache, the reordering is done once per mesh */
+	UPROPERTY(EditAnywhere, Category = "Deform Mesh")
+	bool bOptimizeIndexOrder;
+
+	/** When set, the sections are split in clusters of triangles and only the clusters within reach of the deform transform or a field use the deform vertex factory, the others are drawn with the static mesh vertex factory */
+	UPROPERTY(EditAnywhere, Category = "Deform Mesh")
+	bool bSplitDeformClusters;
+
+	/** When set, the render resources of the sections that are hidden or off-screen for SectionEvictionDelay are released, and restored asynchronously when drawn again */
+	UPROPERTY(EditAnywhere, Category = "Deform Mesh|Residency")
+	bool bReleaseHiddenSections;
+
+	/** Time in seconds a section must go without being drawn before its render resources are released */
+	UPROPERTY(EditAnywhere, Category = "Deform Mesh|Residency", meta = (ClampMin = "0.0", EditCondition = "bReleaseHiddenSections"))
+	float SectionEvictionDelay;
+
+	/** Bytes of section render resources this component keeps resident before releasing the ones not drawn last frame early, 0 for no budget */
+	UPROPERTY(EditAnywhere, Category = "Deform Mesh|Residency", meta = (ClampMin = "0", EditCondition = "bReleaseHiddenSections"))
+	int32 SectionMemoryBudget;
+
+	/** When set, the sections whose deformation didn't change for SettledFramesToBake frames are baked and drawn as static meshes until it changes again
+	 * A transform update only restarts the count if it sets a different transform */
+	UPROPERTY(EditAnywhere, Category = "Deform Mesh|Baking")
+	bool bBakeSettledSections;
+
+	/** Number of frames a section's deformation must stay the same before it's baked */
+	UPROPERTY(EditAnywhere, Category = "Deform Mesh|Baking", meta = (ClampMin = "1", EditCondition = "bBakeSettledSections"))
+	int32 SettledFramesToBake;
+
+	/** Frame counter at the last change of the deformation of each packed section */
+	TArray<uint64> SectionChangeFrames;
+
+	/** Baked positions of each packed section, null for the sections drawn deformed */
+	TArray<TSharedPtr<FDeformMeshBakedSection, ESPMode::ThreadSafe>> SectionBakes;
+
+	/** Bakes running on a worker, by section index since the packed index can move while they run */
+	struct FPendingSectionBake
+	{
+		int32 SectionIndex;
+		uint64 ChangeFrame;
+		FMatrix DeformTransform;
+		TFuture<TArray<FVector>> Positions;
+	};
+	TArray<FPendingSectionBake> PendingSectionBakes;
+
+	/** Sections whose bake was swapped since the last SendRenderDynamicData_Concurrent, by section index */
+	TSet<int32> ChangedSectionBakes;
+
+	/** Assembly the sections are loaded from when the component is registered without sections */
+	UPROPERTY(EditAnywhere, Category = "Deform Mesh")
+	UDeformMeshAssembly* Assembly;
+
+	/** World time of the last FinishTransformsUpdate, the time the pending updates were sampled at */
+	float LastTransformSampleTime;
+
+	/** Quantized section transforms and visibility, replicated when the component is replicated */
+	UPROPERTY(ReplicatedUsing = OnRep_ReplicatedSections)
+	FDeformMeshRepSectionArray ReplicatedSections;
+
 private:
 	virtual FBoxSphereBounds CalcBounds(const FTransform& LocalToWorld) const override;
 	void UpdateLocalBounds();
+	void MarkDeformFieldsDirty();
+	void ResetSectionBVH(int32 DenseIndex);
+
+	/* Start building or refitting the BVHs of the dirty sections on a worker, unless a refit is already running*/
+	void StartSectionBVHRefit();
+
+	/* Wait for the running refit and give its BVHs back to the sections that weren't cleared or recreated meanwhile*/
+	void FinishSectionBVHRefit();
+
+	/* The deformation of the section changed, restart its settling count and stop drawing its bake*/
+	void MarkSectionChanged(int32 DenseIndex);
+
+	/* Start the bakes of the sections that settled and swap in the ones that finished*/
+	void UpdateSectionBakes();
+
+	/* Send the bake of the section to the scene proxy with the other swaps of the frame*/
+	void MarkSectionBakeDirty(int32 DenseIndex);
+
+	/* Tick for the residency policy or the baking, only when one of them is enabled*/
+	void UpdateComponentTick();
+
+	/* Queue the new deform transform of a section for the next FinishTransformsUpdate, replacing its previous pending update*/
+	void QueueTransformUpdate(int32 SectionIndex, const FMatrix& DeformTransform);
+
+	void RebuildSectionHierarchyLevels();
+
+	/* Get the derived data of the sections that don't have it yet, or that miss what the current settings need*/
+	void RefreshSectionDerivedData();
+
+	/* The parts of the derived data that the current settings need*/
+	EDeformMeshDerivedDataFlags GetDerivedDataFlags() const;
+
+	/* Returns the index of the section in the packed arrays, or INDEX_NONE if there's no section at this index*/
+	int32 GetDenseSectionIndex(int32 SectionIndex) const;
+
+	/* Make sure there's a section at this index and return its index in the packed arrays, the slot gets a new generation*/
+	int32 AllocateSectionSlot(int32 SectionIndex);
+
+	/* Remove the section from the packed array and put its index in the free list*/
+	void ReleaseSectionSlot(int32 SectionIndex);
+
+	/* Move the sections loaded in the deprecated DeformMeshSections to the slot table and the packed arrays*/
+	void MigrateDeformMeshSections();
+
+	/* On the server, copy the state of the section to its replicated item and mark it dirty if the quantized state changed*/
+	void UpdateReplicatedSection(int32 SectionIndex, const FTransform* Transform);
+
+	UFUNCTION()
+	void OnRep_ReplicatedSections();
+
+	/* Send the pending transform updates to the render thread*/
+	void SendTransformsUpdate();
+
+	/* Number of section updates and of structured buffer bytes the next send will cost*/
+	int32 GetNumPendingTransformUpdates() const;
+	int32 GetTransformsUploadSize() const;
+	bool HasPendingTransformsUpdate() const;
+
+protected:
+	virtual void Serialize(FArchive& Ar) override;
+	virtual void OnRegister() override;
+	virtual void OnUnregister() override;
+	virtual void TickComponent(float DeltaTime, enum ELevelTick TickType, FActorComponentTickFunction* ThisTickFunction) override;
+	virtual void OnUpdateTransform(EUpdateTransformFlags UpdateTransformFlags, ETeleportType Teleport) override;
+	virtual void SendRenderDynamicData_Concurrent() override;
 public:
-	void CreateMeshSection(int32 SectionIndex, UStaticMesh* Mesh, const FTransform& Transform);
+	UDeformMeshComponent();
+
+	FDeformMeshSectionHandle CreateMeshSection(int32 SectionIndex, UStaticMesh* Mesh, const FTransform& Transform);
+	/* Create a section at the first free section index*/
+	FDeformMeshSectionHandle AddMeshSection(UStaticMesh* Mesh, const FTransform& Transform);
+	/* For a section attached to a parent, the transform is relative to the parent and only applied by the next UpdateSectionHierarchy
+	 * The overall bounds are updated by the next FinishTransformsUpdate*/
 	void UpdateMeshSectionTransform(int32 SectionIndex, const FTransform& Transform);
+
+	/* Attach a section to another one, its transform becomes relative to the parent, INDEX_NONE detaches it
+	 * Returns false if a section doesn't exist or if the parent is a descendant of the section*/
+	bool SetMeshSectionParent(int32 SectionIndex, int32 ParentSectionIndex);
+	int32 GetMeshSectionParent(int32 SectionIndex) const;
+
+	/* Compose the deform transforms of the moved subtrees, level by level on worker threads, called by FinishTransformsUpdate*/
+	void UpdateSectionHierarchy();
+	/* Send the transform updates since the last call to the render thread, as one sample when interpolating*/
 	void FinishTransformsUpdate();
+
+	/* When enabled, the transform updates are sent at a rate depending on the screen size of the component, within a per frame budget*/
+	void SetUseUpdateBudget(bool bEnable);
+
+	/* Use quantized positions for the sections, the quantized stream of each mesh is built the first time it's needed*/
+	void SetQuantizePositions(bool bEnable);
+
+	/* Draw the triangles in vertex cache friendly order, the order of each mesh is computed the first time it's needed*/
+	void SetOptimizeIndexOrder(bool bEnable);
+
+	/* Draw the parts of the sections that no deformer reaches with the cheaper static mesh vertex factory, the clusters of each mesh are built the first time they're needed*/
+	void SetSplitDeformClusters(bool bEnable);
+
+	/* Enable the release of the render resources of the sections that aren't drawn for EvictionDelay seconds, MemoryBudget is in bytes and 0 means no budget*/
+	void SetSectionResidencyPolicy(bool bEnable, float EvictionDelay, int32 MemoryBudget);
+
+	/* Bake the sections whose deformation didn't change for SettledFrames frames, they're drawn deformed again as soon as it changes*/
+	void SetBakeSettledSections(bool bEnable, int32 SettledFrames);
+
+	/* Returns true if the section is currently drawn from its baked positions*/
+	bool IsMeshSectionBaked(int32 SectionIndex) const;
+
+	/* Enable the render thread interpolation of the transforms, the game thread is then expected to update them at SampleRate*/
+	void SetTransformInterpolation(bool bEnable, float SampleRate);
+
+	/* When interpolating, returns true if enough time passed since the last sample to publish a new one, always true otherwise*/
+	bool IsTransformSampleDue() const;
+	/* Replace the sections with the ones of the assembly in one pass, using the bounds and the derived data it saved*/
+	void InitFromAssembly(const UDeformMeshAssembly* InAssembly);
+
+#if WITH_EDITOR
+	/* Save the sections of this component in its Assembly asset, with the derived data the current settings need*/
+	UFUNCTION(CallInEditor, Category = "Deform Mesh")
+	void CaptureToAssembly();
+#endif
+
 	void ClearMeshSection(int32 SectionIndex);
 	void ClearAllMeshSections();
 	void SetMeshSectionVisible(int32 SectionIndex, bool bNewVisibility);
 	bool IsMeshSectionVisible(int32 SectionIndex) const;
+	/* Number of live sections, the section indices can go beyond this number if some sections were cleared*/
 	int32 GetNumSections() const;
-	FDeformMeshSection* GetDeformMeshSection(int32 SectionIndex);
+	FDeformMeshSectionHandle GetSectionHandle(int32 SectionIndex) const;
+	/* Returns the section index of the handle, or INDEX_NONE if its section was cleared*/
+	int32 GetSectionIndex(const FDeformMeshSectionHandle& Handle) const;
+	bool IsValidSectionHandle(const FDeformMeshSectionHandle& Handle) const;
+	/* Copy the section at this index, returns false if there's no section at this index*/
+	bool GetDeformMeshSection(int32 SectionIndex, FDeformMeshSection& OutSection) const;
 	void SetDeformMeshSection(int32 SectionIndex, const FDeformMeshSection& Section);
 
+	/* Set the deform fields affecting this component, called by the UDeformFieldSubsystem, nothing is sent if they didn't change*/
+	void SetDeformFields(TArray<FDeformMeshFieldGPU>&& Fields, TArray<FIntPoint>&& SectionRanges);
+
+	/* Apply the state of a section received from the server*/
+	void ApplyReplicatedSection(const FDeformMeshRepSection& RepSection);
+
+	virtual void GetLifetimeReplicatedProps(TArray<FLifetimeProperty>& OutLifetimeProps) const override;
+
+	/* Build the missing section BVHs and refit the dirty ones, or all of them if forced, and wait for them*/
+	void UpdateSectionBVHs(bool bForceRefit = false);
+
+	/* Traces and overlaps are done against the deformed triangles of the visible sections, when the query collision is enabled*/
+	virtual bool LineTraceComponent(FHitResult& OutHit, const FVector Start, const FVector End, const FCollisionQueryParams& Params) override;
+	virtual bool OverlapComponent(const FVector& Pos, const FQuat& Rot, const FCollisionShape& CollisionShape) override;
+
 	virtual FPrimitiveSceneProxy* CreateSceneProxy() override;
 	virtual int32 GetNumMaterials() const override;
 
 
 	friend class FDeformMeshSceneProxy;
+	friend class UDeformMeshAssembly;
+	friend class UDeformFieldSubsystem;
+	friend class UDeformMeshBudgetSubsystem;
 };
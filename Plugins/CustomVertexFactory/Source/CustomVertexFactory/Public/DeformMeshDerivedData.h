@@ -0,0 +1,184 @@
+﻿// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "RenderResource.h"
+
+class UStaticMesh;
+
+/** The optional parts of FDeformMeshDerivedData */
+enum class EDeformMeshDerivedDataFlags : uint8
+{
+	None = 0,
+	/** 16 bit positions quantized to the vertex bounds */
+	QuantizedPositions = 1 << 0,
+	/** Triangles reordered for the post-transform vertex cache */
+	OptimizedIndices = 1 << 1,
+	/** Triangles grouped in spatial clusters so the ones out of reach of the deformers skip the deform vertex factory */
+	Clusters = 1 << 2,
+};
+ENUM_CLASS_FLAGS(EDeformMeshDerivedDataFlags);
+
+/** A position quantized to 16 bits per component, w is always 65535 so the normalized fetch gives 1 */
+struct FDeformMeshPackedPosition
+{
+	uint16 X;
+	uint16 Y;
+	uint16 Z;
+	uint16 W;
+
+	friend FArchive& operator<<(FArchive& Ar, FDeformMeshPackedPosition& Position)
+	{
+		return Ar << Position.X << Position.Y << Position.Z << Position.W;
+	}
+};
+
+namespace DeformMeshQuantization
+{
+	/* Scale and bias that bring a normalized position back to the box, w is left untouched*/
+	FORCEINLINE void GetDequantization(const FBox& Box, FVector4& OutScale, FVector4& OutBias)
+	{
+		OutScale = FVector4(Box.Max - Box.Min, 1.f);
+		OutBias = FVector4(Box.Min, 0.f);
+	}
+
+	FORCEINLINE FDeformMeshPackedPosition Encode(const FVector& Position, const FBox& Box)
+	{
+		const FVector Size = Box.Max - Box.Min;
+		auto QuantizeAxis = [](float Value, float Min, float Extent) -> uint16
+		{
+			return Extent > 0.f ? (uint16)FMath::Clamp(FMath::RoundToInt((Value - Min) / Extent * 65535.f), 0, 65535) : 0;
+		};
+		return {QuantizeAxis(Position.X, Box.Min.X, Size.X), QuantizeAxis(Position.Y, Box.Min.Y, Size.Y), QuantizeAxis(Position.Z, Box.Min.Z, Size.Z), 65535};
+	}
+
+	/* CPU mirror of the dequantization done by the deform vertex factory*/
+	FORCEINLINE FVector Decode(const FDeformMeshPackedPosition& Packed, const FVector4& Scale, const FVector4& Bias)
+	{
+		return FVector(Packed.X / 65535.f * Scale.X + Bias.X, Packed.Y / 65535.f * Scale.Y + Bias.Y, Packed.Z / 65535.f * Scale.Z + Bias.Z);
+	}
+
+	/* Largest distance on each axis between a position inside the box and its decoded position, half a quantization step*/
+	FORCEINLINE FVector GetMaxError(const FBox& Box)
+	{
+		return (Box.Max - Box.Min) / (2.f * 65535.f);
+	}
+
+	/* GetMaxError plus the float rounding of the decode, which grows with the distance of the box to the origin*/
+	FORCEINLINE FVector GetMaxDecodeError(const FBox& Box)
+	{
+		return GetMaxError(Box) + FVector(FMath::Max(Box.Min.GetAbsMax(), Box.Max.GetAbsMax()) * 1e-6f + KINDA_SMALL_NUMBER);
+	}
+}
+
+/** A range of spatially close triangles in the clustered indices */
+struct FDeformMeshCluster
+{
+	uint32 FirstIndex;
+	uint32 NumTriangles;
+	/** Bounds of the triangles in the local space of the mesh */
+	FBox LocalBox;
+
+	friend FArchive& operator<<(FArchive& Ar, FDeformMeshCluster& Cluster)
+	{
+		return Ar << Cluster.FirstIndex << Cluster.NumTriangles << Cluster.LocalBox;
+	}
+};
+
+/**
+ * Vertex buffer of quantized positions, fetched as VET_UShort4N
+ */
+class CUSTOMVERTEXFACTORY_API FDeformMeshQuantizedPositionBuffer : public FVertexBuffer
+{
+public:
+	/** Freed once uploaded */
+	TResourceArray<FDeformMeshPackedPosition, VERTEXBUFFER_ALIGNMENT> Positions;
+
+	virtual void InitRHI() override;
+	virtual FString GetFriendlyName() const override { return TEXT("FDeformMeshQuantizedPositionBuffer"); }
+};
+
+/**
+ * Render data derived from a static mesh for the deform vertex factory, built once per mesh and shared by all the sections using it
+ */
+class CUSTOMVERTEXFACTORY_API FDeformMeshDerivedData
+{
+private:
+	/** The mesh render data this was built from, a rebuilt mesh gets new derived data */
+	const void* SourceRenderData;
+
+	/** Vertex count, index count and hash of the source indices of the first LOD the indices were derived from
+	 * Saved with the derived indices, loaded ones are only used for a mesh that still matches */
+	uint32 SourceNumVertices;
+	uint32 SourceNumIndices;
+	uint32 SourceIndicesHash;
+
+	FDeformMeshQuantizedPositionBuffer QuantizedPositions;
+	FVector4 PositionScale;
+	FVector4 PositionBias;
+	bool bHasQuantizedPositions;
+
+	/** Parts that were built, successfully or not */
+	EDeformMeshDerivedDataFlags BuiltFlags;
+
+	/** Indices of the first LOD in vertex cache friendly order, empty if the reordering didn't help */
+	TArray<uint32> OptimizedIndices;
+	bool bHasOptimizedIndices;
+
+	/** Indices of the first LOD sorted by cluster, the clusters are in the order of a depth first walk of their k-d tree so neighbours are mostly contiguous */
+	TArray<uint32> ClusteredIndices;
+	TArray<FDeformMeshCluster> Clusters;
+	bool bHasClusters;
+
+	FDeformMeshDerivedData(const void* InSourceRenderData);
+
+	/* Remember what the derived indices are built from*/
+	void SetSourceIndices(int32 NumVertices, const TArray<uint32>& SourceIndices);
+
+	/* Returns true if the derived indices were built from the current first LOD of this mesh*/
+	bool MatchesSourceIndices(const UStaticMesh* StaticMesh) const;
+
+	/* Quantize the positions of the first LOD to its vertex bounds and start the upload*/
+	void BuildQuantizedPositions(const UStaticMesh* StaticMesh);
+
+	/* New derived data, deleted on the render thread with the last reference*/
+	static TSharedPtr<FDeformMeshDerivedData, ESPMode::ThreadSafe> Make(const void* InSourceRenderData);
+
+	/* Reorder the triangles of the first LOD and log the cache efficiency before and after*/
+	void BuildOptimizedIndices(const UStaticMesh* StaticMesh);
+
+	/* Split the triangles of the first LOD in clusters, keeping the optimized order inside each cluster if it was built first*/
+	void BuildClusters(const UStaticMesh* StaticMesh);
+
+public:
+	~FDeformMeshDerivedData();
+
+	/* Returns the derived data of this mesh, building the requested parts on first use, the render resources are released with the last reference
+	 * The missing parts are built in place, in the derived data already shared with the other users of the mesh*/
+	static TSharedPtr<FDeformMeshDerivedData, ESPMode::ThreadSafe> Get(UStaticMesh* StaticMesh, EDeformMeshDerivedDataFlags Flags);
+
+	/* Derived data to fill with Serialize, for data cooked in an asset*/
+	static TSharedPtr<FDeformMeshDerivedData, ESPMode::ThreadSafe> MakeForLoading();
+
+	/* Make loaded derived data the one Get returns for this mesh, unless the mesh already has derived data with at least the same parts
+	 * Loaded derived data built from another version of the mesh is dropped, Get builds it again*/
+	static void Register(UStaticMesh* StaticMesh, const TSharedPtr<FDeformMeshDerivedData, ESPMode::ThreadSafe>& DerivedData);
+
+	/* Save or load the parts that are built from the CPU data, the quantized positions are freed once uploaded so they're built again after loading*/
+	void Serialize(FArchive& Ar);
+
+	/* Returns true if the requested parts were built, or were tried and didn't apply to this mesh*/
+	bool HasBuilt(EDeformMeshDerivedDataFlags Flags) const { return EnumHasAllFlags(BuiltFlags, Flags); }
+
+	bool HasQuantizedPositions() const { return bHasQuantizedPositions; }
+	FDeformMeshQuantizedPositionBuffer* GetQuantizedPositions() { return bHasQuantizedPositions ? &QuantizedPositions : nullptr; }
+	const FVector4& GetPositionScale() const { return PositionScale; }
+	const FVector4& GetPositionBias() const { return PositionBias; }
+	bool HasOptimizedIndices() const { return bHasOptimizedIndices; }
+	/* Written once when built, the later parts don't touch it, so the workers restoring evicted sections can read it*/
+	const TArray<uint32>& GetOptimizedIndices() const { return OptimizedIndices; }
+	bool HasClusters() const { return bHasClusters; }
+	const TArray<uint32>& GetClusteredIndices() const { return ClusteredIndices; }
+	const TArray<FDeformMeshCluster>& GetClusters() const { return Clusters; }
+};
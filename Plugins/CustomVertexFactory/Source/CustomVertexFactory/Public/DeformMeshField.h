@@ -0,0 +1,51 @@
+﻿// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+/**
+ * A spherical world space deformer registered in the UDeformFieldSubsystem
+ * Unlike the section deform transform, a field isn't tied to a mesh section, it deforms every section that its sphere overlaps
+ */
+struct CUSTOMVERTEXFACTORY_API FDeformMeshField
+{
+	/** Center of the field in world space, this is also the pivot of the deform transform */
+	FVector Position;
+
+	/** The deform transform matrix, applied in world space around Position (stored transposed, like FDeformMeshSection::DeformTransform)*/
+	FMatrix DeformTransform;
+
+	/** Radius of influence, the deformation falls off to zero at this distance from Position */
+	float Radius;
+
+	FDeformMeshField()
+		: Position(ForceInitToZero)
+		, DeformTransform(FMatrix::Identity)
+		, Radius(0.f)
+	{}
+
+	/** World space bounding box of the sphere of influence */
+	FBox GetBoundingBox() const
+	{
+		return FBox(Position - FVector(Radius), Position + FVector(Radius));
+	}
+};
+
+/**
+ * Layout of a field entry in the fields structured buffer, must match FDeformMeshField in LocalVertexFactory.ush
+ */
+struct FDeformMeshFieldGPU
+{
+	FMatrix DeformTransform;
+	/** xyz is the world position of the field, w is its radius*/
+	FVector4 PositionAndRadius;
+
+	FDeformMeshFieldGPU()
+	{}
+
+	FDeformMeshFieldGPU(const FDeformMeshField& Field)
+		: DeformTransform(Field.DeformTransform)
+		, PositionAndRadius(Field.Position, Field.Radius)
+	{}
+};
@@ -0,0 +1,23 @@
+﻿// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+/**
+ * Triangle reordering for the post-transform vertex cache, the deform vertex shader is expensive enough that every cache hit counts
+ */
+namespace DeformMeshIndexOptimizer
+{
+	/** Size of the FIFO cache used to measure the index buffers, a conservative size for current GPUs */
+	static constexpr int32 MeasureCacheSize = 16;
+
+	/* Reorder the triangles of a triangle list with Forsyth's linear-speed vertex cache optimisation, returns false if the indices aren't valid*/
+	CUSTOMVERTEXFACTORY_API bool OptimizeTriangleOrder(const TArray<uint32>& Indices, int32 NumVertices, TArray<uint32>& OutIndices);
+
+	/* Average cache miss ratio, vertex shader invocations per triangle, 0.5 at best on a regular grid and 3 at worst*/
+	CUSTOMVERTEXFACTORY_API float CalcACMR(const TArray<uint32>& Indices, int32 NumVertices, int32 CacheSize = MeasureCacheSize);
+
+	/* Average transformed to vertex ratio, vertex shader invocations per referenced vertex, 1 at best*/
+	CUSTOMVERTEXFACTORY_API float CalcATVR(const TArray<uint32>& Indices, int32 NumVertices, int32 CacheSize = MeasureCacheSize);
+}
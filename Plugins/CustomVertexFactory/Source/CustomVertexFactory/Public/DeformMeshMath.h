@@ -0,0 +1,56 @@
+﻿// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "DeformMeshField.h"
+
+/**
+ * CPU evaluation of the deformation done by CalcWorldPosition in LocalVertexFactory.ush
+ * Anything that needs the deformed surface on the CPU (traces, baking...) goes through here so it stays in sync with the shader
+ */
+namespace DeformMeshMath
+{
+	/** Distance from the deform transform origin at which the section deformation has fully faded out */
+	static constexpr float FalloffRadius = 100.f;
+
+	/**
+	 * Returns the deformed world position of a vertex
+	 * @param LocalPosition		Vertex position in the local space of the component
+	 * @param LocalToWorld		Local to world transform of the component
+	 * @param DeformTransform	The section deform transform, as stored in FDeformMeshSection (transposed)
+	 * @param Fields			The deform fields of the section, can be null if NumFields is 0
+	 */
+	FORCEINLINE FVector CalcWorldPosition(const FVector& LocalPosition, const FMatrix& LocalToWorld, const FMatrix& DeformTransform,
+	                                      const FDeformMeshFieldGPU* Fields = nullptr, int32 NumFields = 0)
+	{
+		//The shader reads the transposed matrix row by row, so the rows of the matrix are DeformTransform's columns
+		const FVector AxisX(DeformTransform.M[0][0], DeformTransform.M[1][0], DeformTransform.M[2][0]);
+		const FVector AxisY(DeformTransform.M[0][1], DeformTransform.M[1][1], DeformTransform.M[2][1]);
+		const FVector AxisZ(DeformTransform.M[0][2], DeformTransform.M[1][2], DeformTransform.M[2][2]);
+		const FVector Origin(DeformTransform.M[0][3], DeformTransform.M[1][3], DeformTransform.M[2][3]);
+
+		const FVector OriginalPos = LocalToWorld.TransformPosition(LocalPosition);
+		//Like TransformDeformNotTranslated, the translation of the deform transform isn't applied
+		const FVector DeformedPos = AxisX * LocalPosition.X + AxisY * LocalPosition.Y + AxisZ * LocalPosition.Z;
+
+		const float d = FMath::Square(FMath::Min(FVector::Dist(OriginalPos, Origin), FalloffRadius) / FalloffRadius);
+		FVector Result = FMath::Lerp(DeformedPos, OriginalPos, d);
+
+		for (int32 FieldIndex = 0; FieldIndex < NumFields; FieldIndex++)
+		{
+			const FDeformMeshFieldGPU& Field = Fields[FieldIndex];
+			const FMatrix& FieldTransform = Field.DeformTransform;
+			const FVector FieldPos(Field.PositionAndRadius);
+			const FVector Offset = OriginalPos - FieldPos;
+			const FVector FieldDeformedPos = FieldPos
+				+ FVector(FieldTransform.M[0][0], FieldTransform.M[1][0], FieldTransform.M[2][0]) * Offset.X
+				+ FVector(FieldTransform.M[0][1], FieldTransform.M[1][1], FieldTransform.M[2][1]) * Offset.Y
+				+ FVector(FieldTransform.M[0][2], FieldTransform.M[1][2], FieldTransform.M[2][2]) * Offset.Z
+				+ FVector(FieldTransform.M[0][3], FieldTransform.M[1][3], FieldTransform.M[2][3]);
+			const float w = 1.f - FMath::Clamp(Offset.Size() / FMath::Max(Field.PositionAndRadius.W, 0.0001f), 0.f, 1.f);
+			Result += (FieldDeformedPos - OriginalPos) * (w * w);
+		}
+		return Result;
+	}
+}
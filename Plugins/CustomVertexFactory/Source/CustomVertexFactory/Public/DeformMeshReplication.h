@@ -0,0 +1,130 @@
+﻿// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Net/Serialization/FastArraySerializer.h"
+#include "DeformMeshReplication.generated.h"
+
+class UDeformMeshComponent;
+struct FDeformMeshRepSectionArray;
+
+/**
+ * Quantized deform transform used for replication
+ * The values are quantized when the struct is built, so two transforms that send the same bits compare equal
+ */
+USTRUCT()
+struct CUSTOMVERTEXFACTORY_API FDeformMeshRepTransform
+{
+	GENERATED_BODY()
+public:
+	/** Translation with a 0.1 unit precision */
+	UPROPERTY()
+	FVector Translation;
+
+	/** Rotation with 16 bits per axis */
+	UPROPERTY()
+	FRotator Rotation;
+
+	/** Scale with a 0.01 precision, a unit scale is sent as a single bit */
+	UPROPERTY()
+	FVector Scale;
+
+	FDeformMeshRepTransform()
+		: Translation(ForceInitToZero)
+		, Rotation(ForceInitToZero)
+		, Scale(FVector::OneVector)
+	{}
+
+	explicit FDeformMeshRepTransform(const FTransform& Transform);
+
+	FTransform ToTransform() const;
+
+	bool NetSerialize(FArchive& Ar, class UPackageMap* Map, bool& bOutSuccess);
+
+	bool operator==(const FDeformMeshRepTransform& Other) const
+	{
+		return Translation == Other.Translation && Rotation == Other.Rotation && Scale == Other.Scale;
+	}
+
+	bool operator!=(const FDeformMeshRepTransform& Other) const
+	{
+		return !(*this == Other);
+	}
+};
+
+template<>
+struct TStructOpsTypeTraits<FDeformMeshRepTransform> : public TStructOpsTypeTraitsBase2<FDeformMeshRepTransform>
+{
+	enum
+	{
+		WithNetSerializer = true,
+	};
+};
+
+/**
+ * Replicated state of a mesh section
+ */
+USTRUCT()
+struct CUSTOMVERTEXFACTORY_API FDeformMeshRepSection : public FFastArraySerializerItem
+{
+	GENERATED_BODY()
+public:
+	UPROPERTY()
+	int32 SectionIndex;
+
+	/** The static mesh of the section, null if the section was cleared */
+	UPROPERTY()
+	UStaticMesh* StaticMesh;
+
+	UPROPERTY()
+	FDeformMeshRepTransform Transform;
+
+	UPROPERTY()
+	bool bSectionVisible;
+
+	FDeformMeshRepSection()
+		: SectionIndex(INDEX_NONE)
+		, StaticMesh(nullptr)
+		, bSectionVisible(true)
+	{}
+
+	void PreReplicatedRemove(const FDeformMeshRepSectionArray& InArraySerializer);
+	void PostReplicatedAdd(const FDeformMeshRepSectionArray& InArraySerializer);
+	void PostReplicatedChange(const FDeformMeshRepSectionArray& InArraySerializer);
+};
+
+/**
+ * Replicated sections of a deform mesh component
+ * The fast array only sends the dirty sections, delta compressed against the last state acknowledged by each connection
+ */
+USTRUCT()
+struct CUSTOMVERTEXFACTORY_API FDeformMeshRepSectionArray : public FFastArraySerializer
+{
+	GENERATED_BODY()
+public:
+	/** Items are indexed by section index on the server, clients use FDeformMeshRepSection::SectionIndex */
+	UPROPERTY()
+	TArray<FDeformMeshRepSection> Items;
+
+	/** The component that owns this array, set on both the server and the clients */
+	UDeformMeshComponent* Owner;
+
+	FDeformMeshRepSectionArray()
+		: Owner(nullptr)
+	{}
+
+	bool NetDeltaSerialize(FNetDeltaSerializeInfo& DeltaParms)
+	{
+		return FFastArraySerializer::FastArrayDeltaSerialize<FDeformMeshRepSection, FDeformMeshRepSectionArray>(Items, DeltaParms, *this);
+	}
+};
+
+template<>
+struct TStructOpsTypeTraits<FDeformMeshRepSectionArray> : public TStructOpsTypeTraitsBase2<FDeformMeshRepSectionArray>
+{
+	enum
+	{
+		WithNetDeltaSerializer = true,
+	};
+};
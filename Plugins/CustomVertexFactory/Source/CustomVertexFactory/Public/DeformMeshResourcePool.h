@@ -0,0 +1,93 @@
+﻿// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "DeformMeshDerivedData.h"
+#include "DeformMeshSectionProxy.h"
+
+/**
+ * Structured buffers of a scene proxy, the transforms buffer holds a power of two number of transforms so proxies with close section counts share them
+ */
+struct FDeformMeshPooledBuffers
+{
+	uint32 NumTransforms = 0;
+	FStructuredBufferRHIRef TransformsSB;
+	FShaderResourceViewRHIRef TransformsSRV;
+	FStructuredBufferRHIRef FieldsSB;
+	FShaderResourceViewRHIRef FieldsSRV;
+};
+
+/**
+ * Render thread pool of the resources of the destroyed deform mesh scene proxies
+ * A new scene proxy takes the section proxies of a destroyed one with the same section sources, their index buffers and vertex factories already initialized,
+ * and structured buffers of the same size, so spawning and destroying the same components doesn't create new RHI resources once the pool is warm
+ * The static mesh buffers the pooled vertex factories are bound to may go away with a garbage collection, so the pool is flushed after each one
+ */
+class CUSTOMVERTEXFACTORY_API FDeformMeshResourcePool
+{
+private:
+	/** Section proxies of a destroyed scene proxy, in one block of memory like the scene proxy allocated them */
+	struct FPooledSections
+	{
+		uint32 SourcesHash;
+		ERHIFeatureLevel::Type FeatureLevel;
+		TArray<FDeformMeshSectionSource> Sources;
+		TArrayView<FDeformMeshSectionProxy> Sections;
+		/** Sections whose index buffer and vertex factory are initialized */
+		TBitArray<> Residency;
+		uint32 ResidentBytes;
+		/** Derived data the pooled index buffers and vertex factories were built from, kept alive while they're pooled */
+		TArray<TSharedPtr<FDeformMeshDerivedData, ESPMode::ThreadSafe>> DerivedData;
+	};
+
+	/** Oldest first, the oldest entries are released when the pool is full */
+	TArray<FPooledSections> PooledSections;
+	TArray<FDeformMeshPooledBuffers> PooledBuffers;
+
+	uint32 PooledBytes;
+	uint32 SectionHits;
+	uint32 SectionMisses;
+	uint32 BufferHits;
+	uint32 BufferMisses;
+
+	FDelegateHandle PostGarbageCollectHandle;
+	FDelegateHandle PreExitHandle;
+
+	FDeformMeshResourcePool();
+
+	static uint32 HashSources(const TArray<FDeformMeshSectionSource>& Sources);
+	static uint32 GetBuffersBytes(const FDeformMeshPooledBuffers& Buffers);
+	static void ReleaseSections(TArrayView<FDeformMeshSectionProxy> Sections);
+	void UpdateHitRateStats() const;
+
+public:
+	static FDeformMeshResourcePool& Get();
+
+	/* Flush the pool after each garbage collection and before the engine exits, called by the module*/
+	static void Startup();
+	static void Shutdown();
+
+	/* Number of transforms of the structured buffer holding NumSections transforms*/
+	static uint32 GetTransformsCapacity(int32 NumSections);
+
+	/* Take pooled section proxies built from these sources, returns false if there are none
+	 * OutResidency tells which sections have their index buffer and vertex factory initialized, the scene proxy and transform index of the vertex factories must be set again*/
+	bool AcquireSections_RenderThread(ERHIFeatureLevel::Type FeatureLevel, const TArray<FDeformMeshSectionSource>& Sources, TArrayView<FDeformMeshSectionProxy>& OutSections, TBitArray<>& OutResidency);
+
+	/* Give back the section proxies of a destroyed scene proxy, the oldest pooled ones are released if the pool is full*/
+	void ReleaseSections_RenderThread(TArray<FDeformMeshSectionSource>&& Sources, TArrayView<FDeformMeshSectionProxy> Sections, TBitArray<>&& Residency,
+	                                  uint32 ResidentBytes, TArray<TSharedPtr<FDeformMeshDerivedData, ESPMode::ThreadSafe>>&& DerivedData);
+
+	/* Take pooled structured buffers holding the transforms of NumSections sections, returns false if there are none*/
+	bool AcquireBuffers_RenderThread(int32 NumSections, FDeformMeshPooledBuffers& OutBuffers);
+
+	/* Give back the structured buffers of a destroyed scene proxy, the oldest pooled ones are released if the pool is full*/
+	void ReleaseBuffers_RenderThread(FDeformMeshPooledBuffers&& Buffers);
+
+	/* Release the pooled section proxies, with their render resources, and the pooled structured buffers*/
+	void Flush_RenderThread();
+
+	/* Log the content and the hit rates of the pool*/
+	void Dump_RenderThread() const;
+};
@@ -3,8 +3,11 @@
 #pragma once
 
 #include "CoreMinimal.h"
+#include "DeformMeshBakedSection.h"
 #include "DeformMeshComponent.h"
+#include "DeformMeshDerivedData.h"
 #include "DeformMeshSectionProxy.h"
+#include "Async/Future.h"
 
 /**
  * 
@@ -12,30 +15,127 @@
 class CUSTOMVERTEXFACTORY_API FDeformMeshSceneProxy : public FPrimitiveSceneProxy
 {
 private:
-	TArray<FDeformMeshSectionProxy*> Sections;
+	/** The section proxies, constructed in a single allocation owned by this scene proxy */
+	TArrayView<FDeformMeshSectionProxy> Sections;
+	/** Visibility of each section, kept apart so the draw loop only walks the visible sections */
+	TBitArray<> SectionVisibility;
 	FMaterialRelevance MaterialRelevance;
 	TArray<FMatrix> DeformTransforms;
 	FStructuredBufferRHIRef DeformTransformsSB;
 	FShaderResourceViewRHIRef DeformTransformsSRV;
 	bool bDeformTransformsDirty;
+	TArray<FDeformMeshFieldGPU> DeformFields;
+	FStructuredBufferRHIRef DeformFieldsSB;
+	FShaderResourceViewRHIRef DeformFieldsSRV;
+	/** Offset and count of the fields of each section in DeformFields */
+	TArray<FIntPoint> DeformFieldRanges;
+
+	/** Render thread interpolation of the deform transforms between the two last samples of the game thread */
+	bool bInterpolateTransforms;
+	/** Time the interpolation lags behind the game thread, one sample interval so there's always a sample ahead */
+	float InterpolationDelay;
+	TArray<FTransform> PrevTransformSamples;
+	TArray<FTransform> NextTransformSamples;
+	/** Sections updated by the last sample, the others don't need to be interpolated */
+	TArray<int32> InterpolatedSections;
+	float PrevSampleTime;
+	float NextSampleTime;
+	float LastInterpolationAlpha;
+	uint32 LastInterpolationFrame;
+
+	/** Residency policy, the index buffer and the vertex factory of the sections that aren't drawn for EvictionDelay seconds are released */
+	bool bReleaseHiddenSections;
+	float EvictionDelay;
+	/** Above this number of resident bytes, the sections that weren't drawn in the last frame are released too, 0 for no budget */
+	uint32 ResidentMemoryBudget;
+	uint32 ResidentBytes;
+	/** Sections whose render resources are initialized */
+	TBitArray<> SectionResidency;
+	/** World time each section was last drawn */
+	TArray<float> SectionLastRenderTime;
+	/** Size of the render resources of each section when resident */
+	TArray<uint32> SectionResourceBytes;
+	/** Derived data of the mesh of each section, kept alive while the vertex factories use it */
+	TArray<TSharedPtr<FDeformMeshDerivedData, ESPMode::ThreadSafe>> SectionDerivedData;
+	/** Render data each section proxy is built from, and the material it's drawn with */
+	TArray<FDeformMeshSectionSource> SectionSources;
+	TArray<UMaterialInterface*> SectionMaterials;
+	/** Baked positions of the sections whose deformation settled, they're drawn by DrawStaticElements and skipped by the dynamic path */
+	TArray<TSharedPtr<FDeformMeshBakedSection, ESPMode::ThreadSafe>> SectionBakes;
+	TBitArray<> SectionBaked;
+	/** Set if at least one section is baked, and if at least one isn't */
+	bool bHasBakedSections;
+	bool bHasDynamicSections;
+	/** Latest world time seen by the residency, and the world time of the last frame this proxy was drawn */
+	float ResidencyTime;
+	float LastDrawTime;
+
+	/** Index copies running on a worker for the sections being restored */
+	struct FSectionRestore
+	{
+		int32 DenseIndex;
+		TFuture<TArray<uint32>> Indices;
+	};
+	TArray<FSectionRestore> PendingRestores;
+
+private:
+	/* Write the interpolated transforms of the sections for this world time and upload them*/
+	void InterpolateTransforms_RenderThread(float WorldTime);
+
+	/* Set the fields of each section and upload them, the structured buffer is recreated if it's too small*/
+	void SetDeformFields(TArray<FDeformMeshFieldGPU>&& Fields, const TArray<FIntPoint>& SectionRanges);
+
+	/* Release the index buffer and the vertex factory of the section*/
+	void EvictSection_RenderThread(int32 DenseIndex);
+
+	/* Copy the indices of an evicted section on a worker, the section is drawn again once FinishSectionRestores_RenderThread initialized it*/
+	void RequestSectionRestore_RenderThread(int32 DenseIndex);
+	void FinishSectionRestores_RenderThread();
+
+	/* Build the section proxies and the structured buffers, or take them from the resource pool*/
+	void CreateSections_RenderThread();
+	void CreateBuffers_RenderThread();
+
+	/* Returns true if the deform transform or a field of the section reaches into this world space box*/
+	bool IsDeformedBox(int32 DenseIndex, const FBox& WorldBox) const;
 
 public:
 	FDeformMeshSceneProxy(UDeformMeshComponent* Component);
 	virtual ~FDeformMeshSceneProxy() override;
 
+	/* The section proxies and the structured buffers are created once the proxy is added to the scene, so they can come from the resource pool*/
+	virtual void CreateRenderThreadResources() override;
+
 	/* Update the transforms structured buffer using the array of deform transform, this will update the array on the GPU*/
 	void UpdateDeformTransformsSB_RenderThread();
 
-	/* Update the deform transform that is being used to deform this mesh section, this will just update this section's entry in the CPU array*/
-	void UpdateDeformTransform_RenderThread(int32 SectionIndex, FMatrix Transform);
+	/* Apply the transform updates sent by FinishTransformsUpdate, when interpolating they're the new sample to interpolate to*/
+	void UpdateDeformTransforms_RenderThread(const TArray<FDeformMeshTransformUpdate>& Updates, float SampleTime);
+
+	/* Update the deform transform that is being used to deform this mesh section, this will just update this section's entry in the CPU array
+	 * DenseIndex is the index of the section in the packed sections array of the component*/
+	void UpdateDeformTransform_RenderThread(int32 DenseIndex, FMatrix Transform);
+
+	/* Replace the deform fields affecting the sections of this component*/
+	void UpdateDeformFields_RenderThread(TArray<FDeformMeshFieldGPU>&& Fields, TArray<FIntPoint>&& SectionRanges);
+
+	/* Apply the residency policy at this world time, evicting the sections that weren't drawn for too long or that don't fit in the budget*/
+	void UpdateResidency_RenderThread(float WorldTime);
 
 	/* Update the mesh section's visibility*/
-	void SetSectionVisibility_RenderThread(int32 SectionIndex, bool bNewVisibility);
+	void SetSectionVisibility_RenderThread(int32 DenseIndex, bool bNewVisibility);
+
+	/* Swap the bakes of the sections, a null bake draws the section deformed again
+	 * The static draws are gathered again by the transform update the component sends with the swaps*/
+	void UpdateSectionBakes_RenderThread(const TArray<TPair<int32, TSharedPtr<FDeformMeshBakedSection, ESPMode::ThreadSafe>>>& Bakes);
 
 	/* Given the scene views and the visibility map, we add to the collector the relevant dynamic meshes that need to be rendered by this component*/
 	virtual void GetDynamicMeshElements(const TArray<const FSceneView*>& Views, const FSceneViewFamily& ViewFamily,
 	                                    uint32 VisibilityMap, FMeshElementCollector& Collector) const override;
 
+	/* The baked sections are cached static meshes, the others are drawn every frame by GetDynamicMeshElements*/
+	virtual void DrawStaticElements(FStaticPrimitiveDrawInterface* PDI) override;
+
 	virtual FPrimitiveViewRelevance GetViewRelevance(const FSceneView* View) const override;
 
 	virtual bool CanBeOccluded() const override;
@@ -46,5 +146,7 @@ public:
 
 	//Getter to the SRV of the transforms structured buffer
 	FShaderResourceViewRHIRef& GetDeformTransformsSRV();
+	//Getter to the SRV of the fields structured buffer
+	FShaderResourceViewRHIRef& GetDeformFieldsSRV();
 	virtual SIZE_T GetTypeHash() const override;
 };
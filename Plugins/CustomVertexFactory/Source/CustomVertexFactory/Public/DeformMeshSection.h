@@ -42,3 +42,75 @@ public:
 		bSectionVisible = true;
 	}
 };
+
+/**
+ * Stable reference to a mesh section
+ * Unlike a section index, a handle becomes invalid when its section is cleared, even if the index is later reused by another section
+ */
+USTRUCT(BlueprintType)
+struct CUSTOMVERTEXFACTORY_API FDeformMeshSectionHandle
+{
+	GENERATED_BODY()
+public:
+	/** The section index, this is the index used by the section functions of UDeformMeshComponent */
+	UPROPERTY()
+	int32 Index;
+
+	/** Generation of the section slot when the handle was created */
+	UPROPERTY()
+	uint32 Generation;
+
+	FDeformMeshSectionHandle()
+		: Index(INDEX_NONE)
+		, Generation(0)
+	{}
+
+	FDeformMeshSectionHandle(int32 InIndex, uint32 InGeneration)
+		: Index(InIndex)
+		, Generation(InGeneration)
+	{}
+
+	bool operator==(const FDeformMeshSectionHandle& Other) const
+	{
+		return Index == Other.Index && Generation == Other.Generation;
+	}
+};
+
+/**
+ * Entry of the section slot table, maps a section index to the section in the packed array of live sections
+ */
+USTRUCT()
+struct CUSTOMVERTEXFACTORY_API FDeformMeshSectionSlot
+{
+	GENERATED_BODY()
+public:
+	/** Index of the section in the packed array, INDEX_NONE if the slot is free */
+	UPROPERTY()
+	int32 DenseIndex;
+
+	/** Incremented every time the slot is given a new section or freed, so stale handles can be detected */
+	UPROPERTY()
+	uint32 Generation;
+
+	FDeformMeshSectionSlot()
+		: DenseIndex(INDEX_NONE)
+		, Generation(0)
+	{}
+};
+
+/**
+ * A deform transform update waiting to be sent to the render thread
+ */
+struct FDeformMeshTransformUpdate
+{
+	/** The section index on the game thread, the index in the packed sections once sent to the render thread */
+	int32 Index;
+
+	/** The new deform transform, transposed like the ones in the structured buffer */
+	FMatrix DeformTransform;
+
+	FDeformMeshTransformUpdate(int32 InIndex, const FMatrix& InDeformTransform)
+		: Index(InIndex)
+		, DeformTransform(InDeformTransform)
+	{}
+};
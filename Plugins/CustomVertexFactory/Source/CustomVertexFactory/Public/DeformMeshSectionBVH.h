@@ -0,0 +1,61 @@
+﻿// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+/**
+ * Triangle BVH over the deformed surface of a mesh section
+ * The tree topology is built once from the undeformed positions, when the deformation changes the node bounds are refit instead of rebuilding the tree
+ */
+class CUSTOMVERTEXFACTORY_API FDeformMeshSectionBVH
+{
+public:
+	struct FNode
+	{
+		FBox Bounds;
+		/** Index of the left child (the right child is the next node) for inner nodes, index of the first triangle for leaves */
+		int32 FirstChildOrTriangle;
+		/** Number of triangles for leaves, 0 for inner nodes */
+		int32 NumTriangles;
+	};
+
+private:
+	/** Nodes in depth first order, a parent always comes before its children */
+	TArray<FNode> Nodes;
+
+	/** Vertex indices of the triangles, sorted so the triangles of a leaf are contiguous */
+	TArray<uint32> Indices;
+
+	/** Index of each sorted triangle in the source index buffer */
+	TArray<int32> TriangleIds;
+
+	/** Current (deformed) vertex positions in world space */
+	TArray<FVector> Positions;
+
+	void BuildNode(int32 NodeIndex, int32 FirstTriangle, int32 NumTriangles, const TArray<FVector>& Centroids);
+	void RefitBounds();
+	FBox GetTriangleBounds(int32 Triangle) const;
+
+public:
+	/* Build the tree from the source triangles and the positions used to split them*/
+	void Build(const TArray<uint32>& SourceIndices, TArray<FVector>&& InitialPositions);
+
+	/* Refit the node bounds to the positions, the positions must have the same vertex count as the ones used to build*/
+	void Refit(TArray<FVector>&& NewPositions);
+
+	/* Closest hit along the segment, OutTime is in [0, 1] and is used as the current closest time, so several trees can be traced in a row*/
+	bool LineTrace(const FVector& Start, const FVector& End, float& InOutTime, FVector& OutNormal, int32& OutTriangle) const;
+
+	/* Returns true if any triangle intersects the sphere*/
+	bool OverlapSphere(const FVector& Center, float Radius) const;
+
+	/* Returns true if the bounds of any triangle intersects the box, this is conservative*/
+	bool OverlapBox(const FBox& Box) const;
+
+	int32 GetNumVertices() const { return Positions.Num(); }
+	int32 GetNumTriangles() const { return TriangleIds.Num(); }
+	bool IsEmpty() const { return Nodes.Num() == 0; }
+	FBox GetBounds() const { return Nodes.Num() > 0 ? Nodes[0].Bounds : FBox(ForceInit); }
+	uint32 GetAllocatedSize() const;
+};
@@ -3,8 +3,47 @@
 #pragma once
 
 #include "CoreMinimal.h"
+#include "DeformMeshDerivedData.h"
 #include "DeformMeshVertexFactory.h"
 
+struct FStaticMeshVertexBuffers;
+
+/**
+ * Render data a section proxy is built from, section proxies built from the same sources are interchangeable
+ */
+struct FDeformMeshSectionSource
+{
+	/** Vertex buffers of the static mesh, bound to the vertex factory */
+	FStaticMeshVertexBuffers* VertexBuffers;
+	/** Quantized positions fetched instead of the full precision ones, null if the section doesn't quantize */
+	FDeformMeshQuantizedPositionBuffer* QuantizedPositions;
+	/** Static mesh index buffer the indices are copied from */
+	const FRawStaticIndexBuffer* SourceIndices;
+	/** Reordered or clustered indices of the derived data used instead of the source ones, null when the section draws the triangles in their original order */
+	const TArray<uint32>* DerivedIndices;
+	const TArray<FDeformMeshCluster>* Clusters;
+	const FVertexFactory* StaticVertexFactory;
+	/** Dequantization of the quantized positions, they come with the buffer so they aren't compared */
+	FVector4 PositionScale;
+	FVector4 PositionBias;
+
+	bool operator==(const FDeformMeshSectionSource& Other) const
+	{
+		return VertexBuffers == Other.VertexBuffers && QuantizedPositions == Other.QuantizedPositions &&
+			SourceIndices == Other.SourceIndices && DerivedIndices == Other.DerivedIndices &&
+			Clusters == Other.Clusters && StaticVertexFactory == Other.StaticVertexFactory;
+	}
+
+	friend uint32 GetTypeHash(const FDeformMeshSectionSource& Source)
+	{
+		uint32 Hash = PointerHash(Source.VertexBuffers);
+		Hash = HashCombine(Hash, PointerHash(Source.QuantizedPositions));
+		Hash = HashCombine(Hash, PointerHash(Source.SourceIndices));
+		Hash = HashCombine(Hash, PointerHash(Source.DerivedIndices));
+		return Hash;
+	}
+};
+
 /**
  * 
  */
@@ -14,8 +53,11 @@ public:
 	UMaterialInterface* Material;
 	FRawStaticIndexBuffer IndexBuffer;
 	FDeformMeshVertexFactory VertexFactory;
-	bool bSectionVisible;
 	uint32 MaxVertexIndex;
+	/** Clusters of the index buffer when the section is split, null otherwise */
+	const TArray<FDeformMeshCluster>* Clusters;
+	/** Vertex factory of the static mesh, draws the clusters that no deformer reaches */
+	const FVertexFactory* StaticVertexFactory;
 public:
 	FDeformMeshSectionProxy(ERHIFeatureLevel::Type InFeatureLevel);
 	~FDeformMeshSectionProxy();
@@ -0,0 +1,11 @@
+﻿// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Stats/Stats.h"
+
+CUSTOMVERTEXFACTORY_API DECLARE_LOG_CATEGORY_EXTERN(LogDeformMesh, Log, All);
+
+/** Stats of the deform mesh plugin, use "stat DeformMesh" to display them */
+DECLARE_STATS_GROUP(TEXT("DeformMesh"), STATGROUP_DeformMesh, STATCAT_Advanced);
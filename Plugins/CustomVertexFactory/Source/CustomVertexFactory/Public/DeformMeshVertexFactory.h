@@ -15,7 +15,11 @@ class CUSTOMVERTEXFACTORY_API FDeformMeshVertexFactory : public FLocalVertexFact
 {
 	DECLARE_VERTEX_FACTORY_TYPE(FDeformMeshVertexFactory)
 private:
-	uint16 TransformIndex;
+	uint32 TransformIndex;
+	uint32 FieldOffset;
+	uint32 FieldCount;
+	FVector4 PositionScale;
+	FVector4 PositionBias;
 	FDeformMeshSceneProxy * SceneProxy;
 	
 public:
@@ -26,7 +30,10 @@ public:
 
 	virtual void InitRHI() override;
 
-	void SetTransformIndex(uint16 Index);
+	void SetTransformIndex(uint32 Index);
+	void SetFieldRange(uint32 Offset, uint32 Count);
+	/* Scale and bias applied to the fetched positions, for quantized position streams*/
+	void SetPositionDequantization(const FVector4& Scale, const FVector4& Bias);
 	void SetSceneProxy(FDeformMeshSceneProxy * Proxy);
 
 	
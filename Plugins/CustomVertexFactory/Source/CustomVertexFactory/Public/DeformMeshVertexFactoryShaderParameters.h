@@ -14,6 +14,10 @@ class CUSTOMVERTEXFACTORY_API FDeformMeshVertexFactoryShaderParameters : public
 private:
 	LAYOUT_FIELD(FShaderParameter, TransformIndex);
 	LAYOUT_FIELD(FShaderResourceParameter, TransformsSRV);
+	LAYOUT_FIELD(FShaderParameter, FieldRange);
+	LAYOUT_FIELD(FShaderResourceParameter, FieldsSRV);
+	LAYOUT_FIELD(FShaderParameter, PositionScale);
+	LAYOUT_FIELD(FShaderParameter, PositionBias);
 
 public:
 	FDeformMeshVertexFactoryShaderParameters();
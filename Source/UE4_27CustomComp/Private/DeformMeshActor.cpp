@@ -10,7 +10,11 @@ ADeformMeshActor::ADeformMeshActor()
 	// Set this actor to call Tick() every frame.  You can turn this off to improve performance if you don't need it.
 	PrimaryActorTick.bCanEverTick = true;
 
+	// The server drives the deform transforms, the clients receive them through the component replication
+	bReplicates = true;
+
 	DeformMeshComp = CreateDefaultSubobject<UDeformMeshComponent>(TEXT("Deform Mesh Component"));
+	DeformMeshComp->SetIsReplicated(true);
 	Controller = CreateDefaultSubobject<AActor>(TEXT("Controller"));
 }
 
@@ -18,6 +22,11 @@ ADeformMeshActor::ADeformMeshActor()
 void ADeformMeshActor::BeginPlay()
 {
 	Super::BeginPlay();
+	if (!HasAuthority())
+	{
+		return;
+	}
+
 	const auto Transform = Controller->GetTransform();
 	//We create a new deform mesh section using the static mesh and the transform of the actor
 	DeformMeshComp->CreateMeshSection(0, TestMesh, Transform);
@@ -27,6 +36,11 @@ void ADeformMeshActor::BeginPlay()
 void ADeformMeshActor::Tick(float DeltaTime)
 {
 	Super::Tick(DeltaTime);
+	// When the component interpolates the transforms, we only need to update them at its sample rate
+	if (!HasAuthority() || !DeformMeshComp->IsTransformSampleDue())
+	{
+		return;
+	}
 
 	const auto Transform = Controller->GetTransform();// TestTransform1->GetComponentTransform();
 	//We update the deform transform of the previously created deform mesh section